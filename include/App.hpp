@@ -7,35 +7,9 @@
 #include "BinaryTree.hpp"
 #include "Users.hpp"
 #include "Errors.hpp"
+#include "RandomTree.hpp"
+#include "IntKeyMap.hpp"
 #include <random>
-#include <unordered_set>
-
-BinaryTree<int> RandomTree(int nodes, int depth) {
-    if (nodes > 1001)
-        throw std::runtime_error("Too many nodes: can't generate more than 1001 unique keys in range [0, 1000]");
-
-    BinaryTree<int> rand_tree;
-    std::mt19937 rng(std::random_device{}());
-    std::uniform_int_distribution<int> dist(0, 1000);
-    std::unordered_set<int> unique_keys;
-
-    while (static_cast<int>(unique_keys.size()) < nodes) {
-        unique_keys.insert(dist(rng));
-    }
-
-    std::vector<int> keys(unique_keys.begin(), unique_keys.end());
-    std::shuffle(keys.begin(), keys.end(), rng);
-
-    for (int key : keys) {
-        rand_tree.insert(key, key);
-        if (rand_tree.GetDepth() > depth) {
-            rand_tree.balance();
-        }
-    }
-
-    return rand_tree;
-}
-
 
 void ClearInput() {
     std::cin.clear();
@@ -107,7 +81,9 @@ public:
     BinaryTree<T> tree;
     std::string typeName;
 
-    TreeWrapper(std::string typeName_) : typeName(std::move(typeName_)) {}
+    TreeWrapper(std::string typeName_) : typeName(std::move(typeName_)) {
+        tree.setDeferredDestroy(true); // удаление большого дерева из меню не подвешивает интерфейс
+    }
 
     std::string TypeName() const override { return typeName; }
 
@@ -224,6 +200,90 @@ public:
     }
 };
 
+// то же меню для IntKeyMap: вместо операций над формой дерева - соседние ключи
+template<typename T>
+class IntKeyMapWrapper : public ITreeWrapper {
+public:
+    IntKeyMap<T> map;
+    std::string typeName;
+
+    IntKeyMapWrapper(std::string typeName_) : typeName(std::move(typeName_)) {}
+
+    std::string TypeName() const override { return typeName; }
+
+    static void Print(const T& value) {
+        if constexpr (std::is_same_v<T, std::function<double(double)>>) std::cout << "f(1.0)=" << value(1.0);
+        else std::cout << value;
+    }
+
+    void Menu(std::vector<ITreeWrapper*>&, std::vector<std::string>&) override {
+        while (true) {
+            std::cout << "\n--- Int key map Menu (" << typeName << ") ---\n"
+                      << "1. Insert\n2. Search\n3. Min\n4. Max\n5. Remove\n"
+                      << "6. Traverse (by key)\n7. Successor\n8. Predecessor\n9. Back\n"
+                      << "Choose: ";
+            try {
+                int ch = GetInt();
+                switch (ch) {
+                    case 1: {
+                        int key;
+                        T val = GetTyped<T>("Value: ");
+                        if constexpr (std::is_same_v<T, int>) key = val;
+                        else key = GetInt("Key: ");
+                        map.insert(key, val);
+                        break;
+                    }
+                    case 2: {
+                        T* found = map.search(GetInt("Key: "));
+                        if (found) {
+                            std::cout << "Found: ";
+                            Print(*found);
+                            std::cout << "\n";
+                        } else std::cout << "Not found\n";
+                        break;
+                    }
+                    case 3: std::cout << "Min: "; Print(map.getMin()); std::cout << "\n"; break;
+                    case 4: std::cout << "Max: "; Print(map.getMax()); std::cout << "\n"; break;
+                    case 5: {
+                        int key = GetInt("Key: ");
+                        std::cout << (map.remove(key) ? "Removed.\n" : "Key not found.\n");
+                        break;
+                    }
+                    case 6: {
+                        map.traverse([](int key, const T& value) {
+                            std::cout << key << ": ";
+                            Print(value);
+                            std::cout << " ";
+                        });
+                        std::cout << "\n";
+                        break;
+                    }
+                    case 7:
+                    case 8: {
+                        int key = GetInt("Key: "), next;
+                        bool found = ch == 7 ? map.successor(key, next) : map.predecessor(key, next);
+                        if (found) std::cout << (ch == 7 ? "Successor: " : "Predecessor: ") << next << "\n";
+                        else std::cout << "None\n";
+                        break;
+                    }
+                    case 9: return;
+
+                    default: std::cout << "Invalid option.\n";
+                }
+            } catch (const std::exception& e) {
+                std::cout << "Error: " << e.what() << "\n";
+            }
+        }
+    }
+};
+
+// storage: 1 - BinaryTree, 2 - IntKeyMap
+template<typename T>
+ITreeWrapper* MakeTreeWrapper(const std::string& typeName, int storage) {
+    if (storage == 2) return new IntKeyMapWrapper<T>(typeName);
+    return new TreeWrapper<T>(typeName);
+}
+
 void ShowTypeMenu() {
     std::cout << "Choose data type:\n"
               << "1. int\n2. double\n3. string\n4. complex<double>\n"
@@ -243,15 +303,17 @@ void RunApplication() {
                 case 1: { // Добавление нового дерева
                     ShowTypeMenu();
                     int t = GetInt();
+                    if (t < 1 || t > 7) throw Errors::InvalidArgument();
+                    int storage = GetInt("Storage (1. binary tree 2. radix map by int key): ");
+                    if (storage < 1 || storage > 2) throw Errors::InvalidArgument("Unknown storage");
                     switch (t) {
-                        case 1: trees.push_back(new TreeWrapper<int>("int")); break;
-                        case 2: trees.push_back(new TreeWrapper<double>("double")); break;
-                        case 3: trees.push_back(new TreeWrapper<std::string>("string")); break;
-                        case 4: trees.push_back(new TreeWrapper<std::complex<double>>("complex")); break;
-                        case 5: trees.push_back(new TreeWrapper<std::function<double(double)>>("function")); break;
-                        case 6: trees.push_back(new TreeWrapper<Student>("Student")); break;
-                        case 7: trees.push_back(new TreeWrapper<Teacher>("Teacher")); break;
-                        default: throw Errors::InvalidArgument();
+                        case 1: trees.push_back(MakeTreeWrapper<int>("int", storage)); break;
+                        case 2: trees.push_back(MakeTreeWrapper<double>("double", storage)); break;
+                        case 3: trees.push_back(MakeTreeWrapper<std::string>("string", storage)); break;
+                        case 4: trees.push_back(MakeTreeWrapper<std::complex<double>>("complex", storage)); break;
+                        case 5: trees.push_back(MakeTreeWrapper<std::function<double(double)>>("function", storage)); break;
+                        case 6: trees.push_back(MakeTreeWrapper<Student>("Student", storage)); break;
+                        case 7: trees.push_back(MakeTreeWrapper<Teacher>("Teacher", storage)); break;
                     }
                     treeTypes.push_back(trees.back()->TypeName());
                     std::cout << "Tree created. Index: " << trees.size() - 1 << "\n";
@@ -297,14 +359,21 @@ void RunApplication() {
                 }
                 case 5: { // генерация случайного дерева
                     int nodes = GetInt("Number of nodes: ");
-                    int depth = GetInt("Max depth: ");
+                    const int maxDepth = BinaryTree<int>::kMaxBuildDepth; // см. buildWithDepth
+                    int depth = GetInt("Depth (up to " + std::to_string(maxDepth) + "): ");
                     if (nodes <= 0 || depth <= 0) throw Errors::InvalidArgument("Nodes and depth must be positive.");
-                    BinaryTree<int> rand_tree = RandomTree(nodes, depth);
+                    if (depth > maxDepth) throw Errors::InvalidArgument("Depth must not exceed " + std::to_string(maxDepth) + ".");
+                    int dist = GetInt("Key distribution (1. uniform 2. zipf 3. sequential 4. clustered): ");
+                    if (dist < 1 || dist > 4) throw Errors::InvalidArgument("Unknown distribution");
+                    int shape = GetInt("Shape (1. balanced 2. random 3. skewed): ");
+                    if (shape < 1 || shape > 3) throw Errors::InvalidArgument("Unknown shape");
+                    BinaryTree<int> rand_tree = RandomTree(nodes, depth, static_cast<KeyDistribution>(dist - 1),
+                                                           static_cast<TreeShape>(shape - 1), true);
                     auto* wrapper = new TreeWrapper<int>("RandomTree");
                     wrapper->tree = std::move(rand_tree);
                     trees.push_back(wrapper);
                     treeTypes.push_back("int");
-                    std::cout << "Random tree created with " << nodes << " nodes and max depth " << depth << ".\n";
+                    std::cout << "Random tree created with " << nodes << " nodes and depth " << depth << ".\n";
                     std::cout << "Random tree added as index " << trees.size() - 1 << "\n";
                     break;
                 } 
@@ -4,31 +4,317 @@
 #include <string>
 #include <functional>
 #include <stdexcept>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <type_traits>
+#include <utility>
 #include "Errors.hpp"
+#include "ThreadPool.hpp"
+#include "Reclaimer.hpp"
+#include "Hashing.hpp"
+#include "BloomFilter.hpp"
 #include <iomanip>
+#include <cstdint>
+#include <cmath>
+#include <atomic>
+
+// форма дерева при построении заданной глубины (buildWithDepth):
+// Balanced - корни как можно ближе к середине, Random - случайные, Skewed - прижаты к левому краю
+enum class TreeShape { Balanced, Random, Skewed };
+
+// режим доступа: Splay - найденный или вставленный ключ поднимается в корень,
+// частые ключи оказываются у вершины (для сильно неравномерных обращений). Каждый поиск при этом
+// перестраивает путь и пересчитывает сводки на нём, поэтому на Zipf(1.1) по 10^6 запросов Splay
+// медленнее Static в 1.5-2.5 раза при n до 10^5 и сравнивается с ним только около n = 10^6
+// (benchmark_splay): выигрыш возможен лишь на больших деревьях с очень узким горячим множеством;
+// Scapegoat - глубина не больше log_{3/2} n + 1 за счёт перестройки поддеревьев,
+// без лишних полей в узлах (амортизированно O(log n) на вставку и удаление)
+enum class AccessMode { Static, Splay, Scapegoat };
+
+// дополнение узлов (augmentation): сводка по поддереву, которая пересчитывается по детям
+// (см. pull) - значит, держится при вставке, удалении, поворотах и перестройках.
+// Политика задаёт тип сводки, сводку одного узла и ассоциативное объединение (левое, правое):
+//   using Data = ...;
+//   static Data make(int key, const T& value);
+//   static Data combine(const Data& left, const Data& right);
+// Сводка, которая зависит от формы поддерева, а не только от порядка ключей, задаёт ещё
+//   static Data summarize(int key, const T& value, const Data* left, const Data* right); // nullptr - нет ребёнка
+// NoAugment ничего не хранит и места в узле не занимает
+struct NoAugment {
+    struct Data {};
+    template<typename T>
+    static Data make(int, const T&) { return {}; }
+    static Data combine(const Data&, const Data&) { return {}; }
+};
+
+// сводка узла по сводкам детей: summarize политики, если она есть, иначе make и combine по порядку
+template<typename Augment, typename T, typename = void>
+struct Summarize {
+    using Data = typename Augment::Data;
+    static Data apply(int key, const T& value, const Data* left, const Data* right) {
+        Data summary = Augment::make(key, value);
+        if (left) summary = Augment::combine(*left, summary);
+        if (right) summary = Augment::combine(summary, *right);
+        return summary;
+    }
+};
+
+template<typename Augment, typename T>
+struct Summarize<Augment, T, std::void_t<decltype(Augment::summarize(0, std::declval<const T&>(),
+        static_cast<const typename Augment::Data*>(nullptr), static_cast<const typename Augment::Data*>(nullptr)))>> {
+    using Data = typename Augment::Data;
+    static Data apply(int key, const T& value, const Data* left, const Data* right) {
+        return Augment::summarize(key, value, left, right);
+    }
+};
+
+// структурный хеш поддерева (значения + форма): operator== сразу отвечает false при разных хешах
+// корней, containsSubtree сравнивает поддеревья целиком только там, где хеши совпали.
+// Включается типом дерева, BinaryTree<T, StructuralHash>: остальные деревья не держат 8 байт
+// в каждом узле и не хешируют значение каждого предка при вставке, удалении и поворотах
+struct StructuralHash {
+    using Data = size_t;
+    static constexpr size_t kEmpty = 0x51ed270b27b4cfd3ULL; // хеш пустого поддерева
+    template<typename T>
+    static size_t make(int key, const T& value) { return summarize(key, value, nullptr, nullptr); }
+    static size_t combine(size_t left, size_t right) { return HashCombine(left, right); }
+    template<typename T>
+    static size_t summarize(int, const T& value, const size_t* left, const size_t* right) {
+        return HashCombine(HashCombine(HashValue(value), left ? *left : kEmpty), right ? *right : kEmpty);
+    }
+};
+
+// значения - интервалы [key, EndOf()(value)] (например, окна по времени начала):
+// в узле хранится наибольший правый конец в поддереве, что даёт BinaryTree::overlapping
+template<typename EndOf>
+struct MaxEndpoint {
+    using Data = int;
+    template<typename T>
+    static int make(int, const T& value) { return EndOf()(value); }
+    static int combine(int left, int right) { return std::max(left, right); }
+};
 
-template<typename T>
+template<typename Augment> struct IsMaxEndpoint : std::false_type {};
+template<typename EndOf> struct IsMaxEndpoint<MaxEndpoint<EndOf>> : std::true_type {};
+
+// сводки для BinaryTree::aggregate. Field - функтор поля значения, например
+// struct Gpa { double operator()(const Student& s) const { return s.gpa; } };
+template<typename Field> struct FieldType : FieldType<decltype(&Field::operator())> {};
+template<typename C, typename R, typename A> struct FieldType<R (C::*)(A) const> { using type = std::decay_t<R>; };
+
+// число узлов в поддереве; с ним split и перестройки Scapegoat узнают размеры поддеревьев без обхода
+struct CountAugment {
+    using Data = int;
+    template<typename T>
+    static int make(int, const T&) { return 1; }
+    static int combine(int left, int right) { return left + right; }
+};
+
+template<typename Field>
+struct SumOf {
+    using Data = typename FieldType<Field>::type;
+    template<typename T>
+    static Data make(int, const T& value) { return Field()(value); }
+    static Data combine(const Data& left, const Data& right) { return left + right; }
+};
+
+template<typename Field>
+struct MinOf {
+    using Data = typename FieldType<Field>::type;
+    template<typename T>
+    static Data make(int, const T& value) { return Field()(value); }
+    static Data combine(const Data& left, const Data& right) { return std::min(left, right); }
+};
+
+template<typename Field>
+struct MaxOf {
+    using Data = typename FieldType<Field>::type;
+    template<typename T>
+    static Data make(int, const T& value) { return Field()(value); }
+    static Data combine(const Data& left, const Data& right) { return std::max(left, right); }
+};
+
+// две сводки в одном узле, например AugmentPair<CountAugment, MaxOf<Gpa>>
+template<typename A, typename B>
+struct AugmentPair {
+    using Data = std::pair<typename A::Data, typename B::Data>;
+    template<typename T>
+    static Data make(int key, const T& value) { return {A::make(key, value), B::make(key, value)}; }
+    static Data combine(const Data& left, const Data& right) {
+        return {A::combine(left.first, right.first), B::combine(left.second, right.second)};
+    }
+    template<typename T>
+    static Data summarize(int key, const T& value, const Data* left, const Data* right) {
+        return {Summarize<A, T>::apply(key, value, left ? &left->first : nullptr, right ? &right->first : nullptr),
+                Summarize<B, T>::apply(key, value, left ? &left->second : nullptr, right ? &right->second : nullptr)};
+    }
+};
+
+// есть ли политика Part в Augment (сама по себе или внутри AugmentPair) и её часть сводки
+template<typename Part, typename Augment>
+struct AugmentPart : std::false_type {};
+
+template<typename Part>
+struct AugmentPart<Part, Part> : std::true_type {
+    static const typename Part::Data& get(const typename Part::Data& data) { return data; }
+};
+
+template<typename Part, typename A, typename B>
+struct AugmentPart<Part, AugmentPair<A, B>> : std::bool_constant<AugmentPart<Part, A>::value || AugmentPart<Part, B>::value> {
+    static const typename Part::Data& get(const typename AugmentPair<A, B>::Data& data) {
+        if constexpr (AugmentPart<Part, A>::value) return AugmentPart<Part, A>::get(data.first);
+        else return AugmentPart<Part, B>::get(data.second);
+    }
+};
+
+// место под сводку в узле; пустая сводка хранится как пустой базовый класс (0 байт)
+template<typename Data, bool = std::is_empty<Data>::value>
+struct AugmentSlot {
+    Data summary;
+    explicit AugmentSlot(const Data& data) : summary(data) {}
+    Data& augment() { return summary; }
+    const Data& augment() const { return summary; }
+};
+
+template<typename Data>
+struct AugmentSlot<Data, true> : Data {
+    explicit AugmentSlot(const Data& data) : Data(data) {}
+    Data& augment() { return *this; }
+    const Data& augment() const { return *this; }
+};
+
+template<typename T, typename Augment = NoAugment>
 class BinaryTree {
 private:
-    struct Node {
+    struct Node : AugmentSlot<typename Augment::Data> {
         int key;
         T value;
         Node* left;
         Node* right;
 
-        Node(int k, const T& v) : key(k), value(v), left(nullptr), right(nullptr) {} 
+        Node(int k, const T& v)
+            : AugmentSlot<typename Augment::Data>(Augment::make(k, v)), key(k), value(v), left(nullptr), right(nullptr) {}
     };
 
+    static void pull(Node* node); // пересчитать сводку узла по детям
+    static constexpr bool kHashed = AugmentPart<StructuralHash, Augment>::value;
+    static size_t subtreeHash(Node* node);
+    // число узлов поддерева: из сводки CountAugment за O(1), если она есть, иначе обходом
+    static constexpr bool kCounted = AugmentPart<CountAugment, Augment>::value;
+    static int subtreeSize(Node* node, int depth = 0);
+    static int countNodes(Node* node, int depth);
+    static void rehash(Node* node);
+
     Node* root;
     int size;
-
-    void destroy(Node* node);
-    Node* copy(Node* node) const;
-    Node* insert(Node* node, int key, const T& value);
+    int maxSize; // наибольший размер с последней полной перестройки (для Scapegoat)
+    bool deferredDestroy; // большие деревья освобождаются в фоновом потоке
+    AccessMode accessMode;
+    bool threadedScans; // симметричные обходы по алгоритму Морриса, без стека
+    bool multimap; // повторяющиеся ключи: равный ключ уходит вправо, порядок вставки сохраняется
+    // хеш значения -> узел. Узел удаляется из индекса по хешу, под которым его записали:
+    // значение к тому времени могли поменять через T* из search
+    struct ValueIndex {
+        std::unordered_multimap<size_t, Node*> byHash;
+        std::unordered_map<Node*, size_t> hashOf;
+        void clear() {
+            byHash.clear();
+            hashOf.clear();
+        }
+    };
+    std::unique_ptr<ValueIndex> valueIndex; // если включён
+    std::unique_ptr<BloomFilter> keyFilter; // промахи search отсекаются без спуска, если включён
+
+    Node* minNode; // крайние узлы кешируются, getMin/getMax за O(1)
+    Node* maxNode;
+    // глубина дерева: при вставке только растёт и считается сразу,
+    // после удалений и перестроек пересчитывается лениво в GetDepth
+    mutable int cachedDepth;
+    mutable bool depthStale;
+
+    // адаптивный режим: дерево, которое давно не менялось, ищет по отсортированному массиву
+    // (ключи подряд в памяти, двоичный поиск), а узлы остаются основным хранилищем.
+    // Массив строится лениво, когда чтений с последней записи набралось kFlatMinReads + size / 4
+    // (построение за O(n) окупается), и сбрасывается любой записью - при частых записях его просто нет.
+    // Читатель, набравший порог, строит массив и публикует его одним compare_exchange (проигравший
+    // свою копию выбрасывает); освобождают массив только записи, которые с чтением не пересекаются.
+    // Поэтому поиск по готовому массиву - одна загрузка указателя, без блокировок и счётчиков ссылок
+    struct FlatIndex {
+        std::vector<int> keys;
+        std::vector<Node*> nodes;
+    };
+    static constexpr int kFlatMinReads = 32;
+    bool adaptive;
+    mutable std::atomic<const FlatIndex*> flat;
+    mutable std::atomic<int> readsSinceWrite;
+    // неконстантные search/findByPath отдают T*, и значение могут поменять в обход дерева. После этого
+    // хешам (и индексу значений) верить нельзя до rehash(): сравнения идут по самим значениям.
+    // Константные перегрузки отдают const T* и флаг не трогают
+    bool hashesStale;
+    T* expose(const T* value); // отдать изменяемый указатель на значение наружу
+    void touch(); // вызывается при каждом изменении набора ключей
+    Node* adaptiveSearch(int key) const;
+    static int balancedDepth(int nodes); // глубина дерева из buildBalancedTree
+
+    void indexAdd(Node* node);
+    void indexErase(Node* node);
+    void rebuildIndexes(); // после перестройки дерева целиком
+    void rebuildKeyFilter();
+    Node* lookup(const T& value) const;
+
+    // деревья меньше этого размера обрабатываются последовательно
+    static constexpr int kParallelCutoff = 1 << 14;
+    static int forkDepth(int nodes);
+
+    // depth > 0 - сколько верхних уровней рекурсии раздавать потокам пула (см. forkDepth)
+    static void destroy(Node* node, int depth = 0);
+    Node* detach(); // забрать все узлы, дерево становится пустым
+    void adopt(Node* node, int count);
+    void dispose(Node* node, int count) const; // освободить отцепленные узлы (учитывая deferredDestroy)
+    void release();
+    Node* copy(Node* node, int depth = 0) const;
+    Node* insert(Node* node, int key, const T& value, int level);
     Node* remove(Node* node, int key, bool& success);
+    static Node* detachMin(Node*& subtree);
     Node* search(Node* node, int key) const;
     Node* getMinNode(Node* node) const;
     Node* getMaxNode(Node* node) const;
+    Node* unlinkExtreme(bool leftmost);
+
+    static Node* splay(Node* node, int key);
+
+    // обход LKP (или PKL при reverse) за O(1) памяти: пустые правые (левые) ссылки временно
+    // указывают на следующий узел и восстанавливаются по ходу. Трогает только узлы поддерева node
+    template<typename Visit>
+    static void morris(Node* node, bool reverse, Visit&& visit);
+
+    // перестройка поддерева из тех же узлов: адреса (указатели из search, кеши, индекс) не меняются
+    void collectNodes(Node* node, std::vector<Node*>& out) const;
+    static Node* linkBalanced(const std::vector<Node*>& nodes, int start, int end);
+    Node* rebuildSubtree(Node* node, int count) const;
+    static int scapegoatHeight(int nodes);
+
+    // разрезание и склейка по ссылкам, O(глубины); сводки на пути пересчитываются
+    static Node* splitNode(Node* node, int key, Node*& left, Node*& right); // вернёт узел с key, если он был
+    static void splitLess(Node* node, int key, Node*& left, Node*& right); // left - ключи < key, right - >= key
+    static Node* joinNodes(Node* left, Node* right);
+    // операции над множествами поглощают оба дерева; при совпадении ключей остаётся узел b (union) или a
+    static Node* unionNodes(Node* a, Node* b, int depth);
+    static Node* intersectNodes(Node* a, Node* b, int depth);
+    static Node* differenceNodes(Node* a, Node* b, int depth);
+    using SetOp = Node* (*)(Node*, Node*, int);
+    BinaryTree<T, Augment> setOperation(const BinaryTree<T, Augment>& other, SetOp op) const; // над копиями
+    static BinaryTree<T, Augment> setOperation(BinaryTree<T, Augment>&& a, BinaryTree<T, Augment>&& b, SetOp op);
+    static BinaryTree<T, Augment> adoptSetResult(Node* node, int depth, bool hashesStale);
+    static Node* eraseIf(Node* node, const std::function<bool(const T&)>& pred, int& erased, int depth);
+    void rebalanceAfterInsert(int key);
+    void rebalanceAfterRemove();
+    void restoreScapegoatBound();
 
     void traverse(Node* node, const std::string& order, std::function<void(const T&)> func) const;
     void traverse(std::function<void(int, const T&)> func) const;
@@ -38,16 +324,32 @@ private:
     static Node* parseNode(const std::string& s, size_t& pos);
 
 
-    bool equals(Node* a, Node* b) const;
-    bool containsSubtree(Node* root, Node* sub) const;
+    bool equals(Node* a, Node* b, int depth = 0) const;
+    bool containsSubtree(Node* root, Node* sub, bool trustHashes) const;
     Node* find(Node* node, const T& value) const;
 
-    Node* buildBalancedTree(const std::vector<std::pair<int, T>>& nodes, int start, int end);
-    void inOrderCollect(Node* node, std::vector<std::pair<int, T>>& out) const;
+    Node* buildBalancedTree(const std::vector<std::pair<int, T>>& nodes, int start, int end, int depth = 0);
+    static void sortByKey(std::vector<std::pair<int, T>>& items, size_t start, size_t end, int depth);
+    // корень для items[start..end] и какие поддеревья должны иметь высоту ровно height - 1
+    static int pickShapedRoot(int start, int end, int height, bool exact, TreeShape shape, uint64_t seed,
+                              bool& leftExact, bool& rightExact);
+    Node* buildShaped(const std::vector<std::pair<int, T>>& items, int start, int end,
+                      int height, bool exact, TreeShape shape, uint64_t seed, int depth);
+    void inOrderCollect(Node* node, std::vector<std::pair<int, T>>& out, int depth = 0) const;
+
+    int getDepth(Node* node, int depth = 0) const;
 
-    int getDepth(Node* node) const;
+    Node* mapNode(Node* node, const std::function<T(const T&)>& f, int depth) const;
+    void filterCollect(Node* node, const std::function<bool(const T&)>& p,
+                       std::vector<std::pair<int, T>>& out, int depth) const;
+    template<typename R, typename ReduceOp, typename TransformOp>
+    void accumulate(Node* node, R& acc, const R& identity, ReduceOp& reduce, TransformOp& transform, int depth) const;
 
     void printNode(Node* node, int indent) const;
+    void overlapping(Node* node, int lo, int hi, std::vector<std::pair<int, T>>& out) const;
+    using Summary = std::optional<typename Augment::Data>;
+    static Summary suffixSummary(Node* node, int lo); // ключи >= lo
+    static Summary prefixSummary(Node* node, int hi); // ключи <= hi
 
     bool isValidBST(Node* node, const int* minKey, const int* maxKey) const;
 
@@ -56,14 +358,45 @@ private:
 
 public:
     BinaryTree();
-    BinaryTree(const BinaryTree<T>& other);
+    BinaryTree(const BinaryTree<T, Augment>& other);
+    BinaryTree(BinaryTree<T, Augment>&& other) noexcept;
     ~BinaryTree();
 
+    // деревья больше порога распараллеливания будут удаляться в фоне (деструктор и operator= за O(1))
+    void setDeferredDestroy(bool enabled);
+
+    void setAccessMode(AccessMode mode);
+    AccessMode getAccessMode() const;
+
+    // traverseLKP/traversePKL и сбор узлов для перестроек без рекурсии и стека (обход Морриса).
+    // Обход на время меняет ссылки, поэтому дерево нельзя одновременно читать из нескольких потоков
+    void setThreadedScans(bool enabled);
+
+    // см. FlatIndex: небольшие и редко меняющиеся деревья ищут по плоскому массиву
+    void setAdaptive(bool enabled);
+    bool hasFlatIndex() const;
+
+    // мультиотображение: insert с уже имеющимся ключом добавляет ещё один узел после равных,
+    // search и remove берут самый ранний из них. Выключить можно, только если повторов нет
+    void setMultimap(bool enabled);
+    bool isMultimap() const;
+
     void insert(int key, const T& value);
     bool remove(int key);
-    T* search(int key) const;
+    // удалить все ключи из [lo, hi]: диапазон отрезается двумя split и освобождается целиком, O(log n + k);
+    // пустой диапазон дерево не меняет, в режиме Scapegoat после склейки проверяется граница глубины - O(n)
+    int eraseRange(int lo, int hi);
+    // удалить узлы, для значений которых pred истинен; pred должен быть потокобезопасным
+    int eraseIf(std::function<bool(const T&)> pred);
+    const T* search(int key) const;
+    T* search(int key); // в режиме Splay перестраивает дерево
     T getMin() const;
     T getMax() const;
+    const T& minRef() const;
+    const T& maxRef() const;
+    // извлечь наименьший/наибольший элемент (дерево как очередь с приоритетом)
+    T popMin();
+    T popMax();
 
     void traverseKLP(std::function<void(const T&)> func) const;
     void traverseKPL(std::function<void(const T&)> func) const;
@@ -72,155 +405,891 @@ public:
     void traversePLK(std::function<void(const T&)> func) const;
     void traversePKL(std::function<void(const T&)> func) const;
 
-    BinaryTree<T> map(std::function<T(const T&)> f) const;
-    BinaryTree<T> where(std::function<bool(const T&)> p) const;
-    BinaryTree<T> merge(const BinaryTree<T>& other) const;
-    BinaryTree<T> extractSubtree(int key) const;
+    // итератор LKP со стеком предков (в узлах нет ссылки на родителя): ++ за амортизированное O(1).
+    // Любое изменение дерева делает итераторы недействительными
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        const_iterator() = default;
+
+        reference operator*() const { return stack.back()->value; }
+        pointer operator->() const { return &stack.back()->value; }
+        int key() const { return stack.back()->key; }
+
+        const_iterator& operator++() {
+            Node* node = stack.back();
+            stack.pop_back();
+            pushLeft(node->right);
+            return *this;
+        }
+        const_iterator operator++(int) {
+            const_iterator old = *this;
+            ++*this;
+            return old;
+        }
+
+        bool operator==(const const_iterator& other) const {
+            if (stack.empty() || other.stack.empty()) return stack.empty() && other.stack.empty();
+            return stack.back() == other.stack.back();
+        }
+        bool operator!=(const const_iterator& other) const { return !(*this == other); }
+
+    private:
+        friend class BinaryTree<T, Augment>;
+        std::vector<Node*> stack; // узлы, к которым ещё вернёмся; текущий - на вершине
+
+        explicit const_iterator(Node* root) { pushLeft(root); }
+        void pushLeft(Node* node) {
+            for (; node; node = node->left) stack.push_back(node);
+        }
+    };
 
-    bool containsSubtree(const BinaryTree<T>& sub) const;
+    const_iterator begin() const;
+    const_iterator end() const;
+    const_iterator lowerBound(int key) const; // первый узел с ключом >= key
+    const_iterator upperBound(int key) const; // первый узел с ключом > key
+    // все узлы с ключом key в порядке вставки, O(log n + k)
+    std::pair<const_iterator, const_iterator> equalRange(int key) const;
+    int count(int key) const;
+
+    BinaryTree<T, Augment> map(std::function<T(const T&)> f) const;
+    BinaryTree<T, Augment> where(std::function<bool(const T&)> p) const;
+
+    // свёртка в порядке LKP; op должна быть ассоциативной и потокобезопасной
+    T reduce(T identity, std::function<T(const T&, const T&)> op) const;
+    template<typename R, typename ReduceOp, typename TransformOp>
+    R transformReduce(R identity, ReduceOp reduce, TransformOp transform) const;
+
+    BinaryTree<T, Augment> merge(const BinaryTree<T, Augment>& other) const;
+
+    // разрезает дерево: в first - ключи < key, в second - >= key; само дерево становится пустым.
+    // узлы не копируются, перецепляется только путь до key. join работает за O(глубины), split - тоже,
+    // если в Augment есть CountAugment (размер части берётся из сводки), иначе левая часть пересчитывается
+    // обходом. Индекс значений и фильтр ключей перестраиваются по всем узлам; в режиме Scapegoat
+    // результат дополнительно проверяется на границу глубины и при нарушении перестраивается - O(n)
+    std::pair<BinaryTree<T, Augment>, BinaryTree<T, Augment>> split(int key);
+    // склеивает деревья, если все ключи left меньше всех ключей right (иначе InvalidArgument)
+    static BinaryTree<T, Augment> join(BinaryTree<T, Augment>&& left, BinaryTree<T, Augment>&& right);
+
+    // через split/join, поддеревья обрабатываются параллельно; при совпадении ключей в unionWith
+    // побеждает other (как в merge), в intersect - значение из этого дерева. Мультиотображения не принимаются
+    BinaryTree<T, Augment> unionWith(const BinaryTree<T, Augment>& other) const;
+    BinaryTree<T, Augment> intersect(const BinaryTree<T, Augment>& other) const;
+    BinaryTree<T, Augment> difference(const BinaryTree<T, Augment>& other) const;
+    // то же без копирования: узлы забираются из a и b (как в join), оба дерева становятся пустыми;
+    // a играет роль this, b - other
+    static BinaryTree<T, Augment> unionWith(BinaryTree<T, Augment>&& a, BinaryTree<T, Augment>&& b);
+    static BinaryTree<T, Augment> intersect(BinaryTree<T, Augment>&& a, BinaryTree<T, Augment>&& b);
+    static BinaryTree<T, Augment> difference(BinaryTree<T, Augment>&& a, BinaryTree<T, Augment>&& b);
+    BinaryTree<T, Augment> extractSubtree(int key) const;
+
+    // интервалы [key, end], пересекающие [lo, hi] (концы включительно), по возрастанию key.
+    // Поддеревья, где наибольший конец < lo или все начала > hi, не посещаются. Только для MaxEndpoint
+    std::vector<std::pair<int, T>> overlapping(int lo, int hi) const;
+
+    // сводка Augment по ключам из [lo, hi] в порядке возрастания ключей, O(глубины): поддеревья,
+    // целиком попавшие в диапазон, отдают готовую сводку. Пустой диапазон - std::nullopt
+    std::optional<typename Augment::Data> aggregate(int lo, int hi) const;
+
+    bool containsSubtree(const BinaryTree<T, Augment>& sub) const;
     bool containsNode(const T& value) const;
 
+    // индекс значение -> узел: containsNode и findByRelativePath за O(1) в среднем.
+    // при повторяющихся значениях возвращается любой из подходящих узлов
+    void enableValueIndex();
+    void disableValueIndex();
+
+    // фильтр Блума по ключам перед search: дополняется при вставке, перестраивается при balance
+    // и других перестройках, а также при росте дерева сверх расчётного размера.
+    // Удалённые ключи остаются в фильтре до перестройки - это лишь ложные срабатывания
+    void enableKeyFilter();
+    void disableKeyFilter();
+
     std::string toString() const;
-    static BinaryTree<T> fromString(const std::string& str);
+    // пары (ключ, значение) по возрастанию ключей - снимок для статических индексов (LearnedIndex)
+    std::vector<std::pair<int, T>> toSortedVector() const;
+    static BinaryTree<T, Augment> fromString(const std::string& str);
     bool isValidTreeString(const std::string& s);
 
-    T* findByPath(const std::string& path) const;
-    T* findByRelativePath(const std::string& path, const T& from) const;
+    const T* findByPath(const std::string& path) const;
+    T* findByPath(const std::string& path);
+    const T* findByRelativePath(const std::string& path, const T& from) const;
+    T* findByRelativePath(const std::string& path, const T& from);
+
+    // загрузка пар (ключ, значение) разом: при повторе ключа побеждает последняя пара, как при insert
+    template<typename InputIt>
+    void bulkLoad(InputIt first, InputIt last);
+    template<typename Range>
+    void bulkLoad(const Range& items);
+
+    // строит дерево ровно заданной глубины из пар, отсортированных по возрастанию уникальных ключей
+    // (без вставок, большие деревья - параллельно); одинаковый seed - одинаковая форма.
+    // Глубина не больше kMaxBuildDepth: само построение идёт без рекурсии, но удаление, копирование,
+    // сравнение и печать рекурсивны по уровням и на более глубоком дереве переполнили бы стек
+    static constexpr int kMaxBuildDepth = 10000;
+    void buildWithDepth(const std::vector<std::pair<int, T>>& items, int depth,
+                        TreeShape shape = TreeShape::Balanced, uint64_t seed = 0);
 
     void balance();
+    // O(1) после вставок в Static и Scapegoat, balance, bulkLoad и buildWithDepth.
+    // После удаления, splay, split/join и перестройки поддерева первый вызов обходит дерево за O(n):
+    // точная глубина без высоты в каждом узле поддерживается только пересчётом
     int GetDepth() const;
 
-    BinaryTree<T>& operator=(const BinaryTree<T>& other);
+    BinaryTree<T, Augment>& operator=(const BinaryTree<T, Augment>& other);
+    BinaryTree<T, Augment>& operator=(BinaryTree<T, Augment>&& other) noexcept;
 
     void PrintTree() const;
 
-    bool operator==(const BinaryTree<T>& other) const;
-    bool operator!=(const BinaryTree<T>& other) const;
+    // сравнивает значения и форму; в BinaryTree<T, StructuralHash> при несовпадении хешей корней -
+    // сразу false (если значения не менялись через указатели после последнего rehash)
+    bool operator==(const BinaryTree<T, Augment>& other) const;
+    bool operator!=(const BinaryTree<T, Augment>& other) const;
+
+    // пересчитать хеши и сводки, если значения менялись через указатели из search/findByPath
+    void rehash();
 
 };
 
 
 
-template<typename T>
-BinaryTree<T>::BinaryTree() : root(nullptr), size(0) {}
+template<typename T, typename Augment>
+BinaryTree<T, Augment>::BinaryTree()
+    : root(nullptr), size(0), maxSize(0), deferredDestroy(false), accessMode(AccessMode::Static), threadedScans(false), multimap(false), minNode(nullptr), maxNode(nullptr), cachedDepth(0), depthStale(false),
+      adaptive(false), flat(nullptr), readsSinceWrite(0), hashesStale(false) {}
+
+template<typename T, typename Augment>
+BinaryTree<T, Augment>::BinaryTree(const BinaryTree<T, Augment>& other)
+    : root(copy(other.root, forkDepth(other.size))), size(other.size), maxSize(other.size), deferredDestroy(other.deferredDestroy), accessMode(other.accessMode),
+      threadedScans(other.threadedScans), multimap(other.multimap),
+      minNode(nullptr), maxNode(nullptr), cachedDepth(0), depthStale(false), adaptive(other.adaptive), flat(nullptr), readsSinceWrite(0),
+      hashesStale(other.hashesStale) {
+    if (other.valueIndex) valueIndex = std::make_unique<ValueIndex>();
+    if (other.keyFilter) keyFilter = std::make_unique<BloomFilter>();
+    rebuildIndexes();
+    cachedDepth = other.cachedDepth; // форма та же
+    depthStale = other.depthStale;
+}
+
+template<typename T, typename Augment>
+BinaryTree<T, Augment>::BinaryTree(BinaryTree<T, Augment>&& other) noexcept
+    : root(other.root), size(other.size), maxSize(other.maxSize), deferredDestroy(other.deferredDestroy), accessMode(other.accessMode), threadedScans(other.threadedScans), multimap(other.multimap),
+      valueIndex(std::move(other.valueIndex)),
+      keyFilter(std::move(other.keyFilter)),
+      minNode(other.minNode), maxNode(other.maxNode), cachedDepth(other.cachedDepth), depthStale(other.depthStale),
+      adaptive(other.adaptive), flat(other.flat.exchange(nullptr)), readsSinceWrite(other.readsSinceWrite.load(std::memory_order_relaxed)),
+      hashesStale(other.hashesStale) {
+    other.root = nullptr;
+    other.size = other.maxSize = 0;
+    other.minNode = other.maxNode = nullptr;
+    other.cachedDepth = 0;
+    other.depthStale = false;
+    other.touch();
+}
+
+template<typename T, typename Augment>
+BinaryTree<T, Augment>::~BinaryTree() {
+    release();
+}
+
+template<typename T, typename Augment>
+void BinaryTree<T, Augment>::setDeferredDestroy(bool enabled) {
+    deferredDestroy = enabled;
+}
+
+template<typename T, typename Augment>
+void BinaryTree<T, Augment>::setAccessMode(AccessMode mode) {
+    accessMode = mode;
+    if (mode == AccessMode::Scapegoat) { // уже построенное дерево сразу приводим к нужной глубине
+        maxSize = size;
+        restoreScapegoatBound();
+    }
+}
 
-template<typename T>
-BinaryTree<T>::BinaryTree(const BinaryTree<T>& other) : root(copy(other.root)), size(other.size) {}
+// после операций, которые меняют форму в обход rebalanceAfterInsert/Remove (split, join, eraseRange, operator=):
+// глубина проверяется полным обходом, при нарушении границы дерево перестраивается целиком - O(n)
+template<typename T, typename Augment>
+void BinaryTree<T, Augment>::restoreScapegoatBound() {
+    if (accessMode != AccessMode::Scapegoat || GetDepth() - 1 <= scapegoatHeight(size)) return;
+    root = rebuildSubtree(root, size);
+    maxSize = size;
+    cachedDepth = balancedDepth(size);
+    depthStale = false;
+}
 
-template<typename T>
-BinaryTree<T>::~BinaryTree() {
-    destroy(root);
+template<typename T, typename Augment>
+AccessMode BinaryTree<T, Augment>::getAccessMode() const {
+    return accessMode;
+}
+
+template<typename T, typename Augment>
+void BinaryTree<T, Augment>::setThreadedScans(bool enabled) {
+    threadedScans = enabled;
+}
+
+template<typename T, typename Augment>
+void BinaryTree<T, Augment>::setMultimap(bool enabled) {
+    if (!enabled && multimap) {
+        const_iterator it = begin(), next = begin();
+        if (next != end()) ++next;
+        for (; next != end(); ++it, ++next)
+            if (it.key() == next.key()) throw Errors::InvalidArgument("tree has duplicate keys");
+    }
+    multimap = enabled;
+}
+
+template<typename T, typename Augment>
+bool BinaryTree<T, Augment>::isMultimap() const {
+    return multimap;
+}
+
+template<typename T, typename Augment>
+void BinaryTree<T, Augment>::setAdaptive(bool enabled) {
+    adaptive = enabled;
+    touch();
+}
+
+template<typename T, typename Augment>
+bool BinaryTree<T, Augment>::hasFlatIndex() const {
+    return flat.load(std::memory_order_acquire) != nullptr;
+}
+
+template<typename T, typename Augment>
+void BinaryTree<T, Augment>::touch() {
+    delete flat.exchange(nullptr, std::memory_order_acq_rel);
+    readsSinceWrite.store(0, std::memory_order_relaxed);
+}
+
+// несколько потоков могут одновременно построить массив - публикуется первый, остальные удаляются
+template<typename T, typename Augment>
+typename BinaryTree<T, Augment>::Node* BinaryTree<T, Augment>::adaptiveSearch(int key) const {
+    const FlatIndex* snapshot = flat.load(std::memory_order_acquire);
+    if (!snapshot) {
+        if (readsSinceWrite.fetch_add(1, std::memory_order_relaxed) + 1 < kFlatMinReads + size / 4)
+            return search(root, key);
+        auto built = std::make_unique<FlatIndex>();
+        built->keys.reserve(size);
+        built->nodes.reserve(size);
+        for (const_iterator it = begin(); it != end(); ++it) {
+            built->keys.push_back(it.key());
+            built->nodes.push_back(it.stack.back());
+        }
+        const FlatIndex* expected = nullptr;
+        if (flat.compare_exchange_strong(expected, built.get(), std::memory_order_acq_rel)) snapshot = built.release();
+        else snapshot = expected;
+    }
+    if (snapshot->keys.empty()) return nullptr;
+    // двоичный поиск без ветвлений по результату сравнения: шаг умножается на 0 или 1,
+    // и случайные ключи не сбивают предсказатель переходов (при спуске по узлам - сбивают)
+    const int* base = snapshot->keys.data();
+    for (size_t count = snapshot->keys.size(); count > 1; count -= count / 2)
+        base += static_cast<size_t>(base[count / 2] < key) * (count / 2);
+    base += *base < key;
+    size_t pos = static_cast<size_t>(base - snapshot->keys.data());
+    if (pos == snapshot->keys.size() || *base != key) return nullptr;
+    return snapshot->nodes[pos];
+}
+
+// если visit бросит исключение, обход доходит до конца без visit, чтобы вернуть ссылки на место
+template<typename T, typename Augment>
+template<typename Visit>
+void BinaryTree<T, Augment>::morris(Node* node, bool reverse, Visit&& visit) {
+    auto near = [reverse](Node* n) -> Node*& { return reverse ? n->right : n->left; };
+    auto far = [reverse](Node* n) -> Node*& { return reverse ? n->left : n->right; };
+    std::exception_ptr error;
+    auto emit = [&](Node* n) {
+        if (error) return;
+        try {
+            visit(n);
+        } catch (...) {
+            error = std::current_exception();
+        }
+    };
+    while (node) {
+        if (!near(node)) {
+            emit(node);
+            node = far(node);
+            continue;
+        }
+        Node* prev = near(node); // предшественник: крайний узел ближнего поддерева
+        while (far(prev) && far(prev) != node) prev = far(prev);
+        if (!far(prev)) { // первый заход: прокладываем нить и спускаемся
+            far(prev) = node;
+            node = near(node);
+        } else { // второй заход по нити: убираем её
+            far(prev) = nullptr;
+            emit(node);
+            node = far(node);
+        }
+    }
+    if (error) std::rethrow_exception(error);
 }
 
-template<typename T>
-void BinaryTree<T>::destroy(Node* node) {
+template<typename T, typename Augment>
+typename BinaryTree<T, Augment>::Node* BinaryTree<T, Augment>::detach() {
+    Node* detached = root;
+    root = nullptr;
+    size = maxSize = 0;
+    minNode = maxNode = nullptr;
+    cachedDepth = 0;
+    depthStale = false;
+    if (valueIndex) valueIndex->clear();
+    if (keyFilter) keyFilter->clear();
+    touch();
+    return detached;
+}
+
+// пустое дерево принимает готовые узлы
+template<typename T, typename Augment>
+void BinaryTree<T, Augment>::adopt(Node* node, int count) {
+    root = node;
+    size = count;
+    rebuildIndexes();
+}
+
+// отцепляет все узлы от дерева и освобождает их - сразу или в фоновом потоке
+template<typename T, typename Augment>
+void BinaryTree<T, Augment>::release() {
+    int count = size;
+    dispose(detach(), count);
+}
+
+template<typename T, typename Augment>
+void BinaryTree<T, Augment>::dispose(Node* node, int count) const {
+    if (deferredDestroy && count >= kParallelCutoff) {
+        Reclaimer::Defer([node] { destroy(node); });
+        return;
+    }
+    destroy(node, forkDepth(count));
+}
+
+template<typename T, typename Augment>
+void BinaryTree<T, Augment>::destroy(Node* node, int depth) {
     if (!node) return;
-    destroy(node->left);
-    destroy(node->right);
+    if (depth > 0) {
+        ThreadPool::Instance().Invoke(
+            [&] { destroy(node->left, depth - 1); },
+            [&] { destroy(node->right, depth - 1); });
+    } else {
+        destroy(node->left);
+        destroy(node->right);
+    }
     delete node;
 }
 
-template<typename T>
-typename BinaryTree<T>::Node* BinaryTree<T>::insert(Node* node, int key, const T& value) {
+template<typename T, typename Augment>
+void BinaryTree<T, Augment>::pull(Node* node) {
+    node->augment() = Summarize<Augment, T>::apply(node->key, node->value,
+        node->left ? &node->left->augment() : nullptr, node->right ? &node->right->augment() : nullptr);
+}
+
+template<typename T, typename Augment>
+int BinaryTree<T, Augment>::subtreeSize(Node* node, int depth) {
+    if constexpr (kCounted) return node ? AugmentPart<CountAugment, Augment>::get(node->augment()) : 0;
+    else return countNodes(node, depth);
+}
+
+template<typename T, typename Augment>
+int BinaryTree<T, Augment>::countNodes(Node* node, int depth) {
+    if (!node) return 0;
+    if (depth > 0) {
+        int left = 0, right = 0;
+        ThreadPool::Instance().Invoke(
+            [&] { left = countNodes(node->left, depth - 1); },
+            [&] { right = countNodes(node->right, depth - 1); });
+        return 1 + left + right;
+    }
+    return 1 + countNodes(node->left, 0) + countNodes(node->right, 0);
+}
+
+template<typename T, typename Augment>
+size_t BinaryTree<T, Augment>::subtreeHash(Node* node) {
+    if constexpr (kHashed) return node ? AugmentPart<StructuralHash, Augment>::get(node->augment()) : StructuralHash::kEmpty;
+    else return 0;
+}
+
+template<typename T, typename Augment>
+void BinaryTree<T, Augment>::rehash(Node* node) {
+    if (!node) return;
+    rehash(node->left);
+    rehash(node->right);
+    pull(node);
+}
+
+template<typename T, typename Augment>
+void BinaryTree<T, Augment>::rehash() {
+    rehash(root);
+    rebuildIndexes();
+    hashesStale = false;
+}
+
+template<typename T, typename Augment>
+T* BinaryTree<T, Augment>::expose(const T* value) {
+    if (value) hashesStale = true;
+    return const_cast<T*>(value);
+}
+
+template<typename T, typename Augment>
+void BinaryTree<T, Augment>::indexAdd(Node* node) {
+    if (!valueIndex) return;
+    size_t hash = HashValue(node->value);
+    valueIndex->byHash.emplace(hash, node);
+    valueIndex->hashOf[node] = hash;
+}
+
+template<typename T, typename Augment>
+void BinaryTree<T, Augment>::indexErase(Node* node) {
+    if (!valueIndex) return;
+    auto entry = valueIndex->hashOf.find(node);
+    if (entry == valueIndex->hashOf.end()) return;
+    auto range = valueIndex->byHash.equal_range(entry->second);
+    valueIndex->hashOf.erase(entry);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == node) {
+            valueIndex->byHash.erase(it);
+            return;
+        }
+    }
+}
+
+template<typename T, typename Augment>
+void BinaryTree<T, Augment>::rebuildIndexes() {
+    maxSize = size;
+    touch();
+    if (keyFilter) rebuildKeyFilter();
+    minNode = getMinNode(root);
+    maxNode = getMaxNode(root);
+    depthStale = true;
+    if (valueIndex) {
+        valueIndex->clear();
+        valueIndex->byHash.reserve(size);
+        valueIndex->hashOf.reserve(size);
+        std::vector<Node*> stack;
+        if (root) stack.push_back(root);
+        while (!stack.empty()) {
+            Node* node = stack.back();
+            stack.pop_back();
+            indexAdd(node);
+            if (node->left) stack.push_back(node->left);
+            if (node->right) stack.push_back(node->right);
+        }
+    }
+}
+
+template<typename T, typename Augment>
+void BinaryTree<T, Augment>::enableValueIndex() {
+    static_assert(IsHashable<T>::value, "value index requires std::hash<T>");
+    if (!valueIndex) valueIndex = std::make_unique<ValueIndex>();
+    rebuildIndexes();
+}
+
+template<typename T, typename Augment>
+void BinaryTree<T, Augment>::disableValueIndex() {
+    valueIndex.reset();
+}
+
+template<typename T, typename Augment>
+void BinaryTree<T, Augment>::enableKeyFilter() {
+    keyFilter = std::make_unique<BloomFilter>();
+    rebuildKeyFilter();
+}
+
+template<typename T, typename Augment>
+void BinaryTree<T, Augment>::disableKeyFilter() {
+    keyFilter.reset();
+}
+
+// с запасом вдвое, чтобы вставки не перестраивали фильтр слишком часто
+template<typename T, typename Augment>
+void BinaryTree<T, Augment>::rebuildKeyFilter() {
+    *keyFilter = BloomFilter(std::max<size_t>(1024, 2 * static_cast<size_t>(size)));
+    for (const_iterator it = begin(); it != end(); ++it) keyFilter->add(it.key());
+}
+
+template<typename T, typename Augment>
+typename BinaryTree<T, Augment>::Node* BinaryTree<T, Augment>::lookup(const T& value) const {
+    if (!valueIndex) return find(root, value);
+    auto range = valueIndex->byHash.equal_range(HashValue(value));
+    for (auto it = range.first; it != range.second; ++it)
+        if (it->second->value == value) return it->second;
+    // значение могли поменять через указатель - тогда узел лежит в индексе под старым хешем
+    return hashesStale ? find(root, value) : nullptr;
+}
+
+template<typename T, typename Augment>
+typename BinaryTree<T, Augment>::Node* BinaryTree<T, Augment>::insert(Node* node, int key, const T& value, int level) {
     if (!node) {
         ++size;
-        return new Node(key, value);
+        Node* created = new Node(key, value);
+        indexAdd(created);
+        if (!minNode || key < minNode->key) minNode = created;
+        if (!maxNode || key >= maxNode->key) maxNode = created; // повтор максимума (multimap) встаёт правее всех
+        if (level > cachedDepth) cachedDepth = level; // level - глубина нового узла (корень - 1)
+        return created;
     }
     if (key < node->key) {
-        node->left = insert(node->left, key, value);
-    } else if (key > node->key) {
-        node->right = insert(node->right, key, value);
+        node->left = insert(node->left, key, value, level + 1);
+    } else if (key > node->key || multimap) {
+        node->right = insert(node->right, key, value, level + 1);
     } else {
+        indexErase(node);
         node->value = value;
+        indexAdd(node);
     }
+    pull(node); // сводки меняются только на пути вставки
     return node;
 }
 
 
-template<typename T>
-void BinaryTree<T>::insert(int key, const T& value) {
-    root = insert(root, key, value);
+template<typename T, typename Augment>
+void BinaryTree<T, Augment>::insert(int key, const T& value) {
+    int before = size;
+    root = insert(root, key, value, 1);
+    if (size != before) {
+        touch();
+        if (keyFilter) {
+            if (keyFilter->size() >= keyFilter->expected()) rebuildKeyFilter(); // новый ключ уже в дереве
+            else keyFilter->add(key);
+        }
+    }
+    if (accessMode == AccessMode::Splay) {
+        root = splay(root, key);
+        depthStale = true;
+    } else if (accessMode == AccessMode::Scapegoat && size > before) {
+        maxSize = std::max(maxSize, size);
+        rebalanceAfterInsert(key);
+    }
+}
+
+// допустимая глубина (в рёбрах) для Scapegoat: floor(log_{3/2} n)
+template<typename T, typename Augment>
+int BinaryTree<T, Augment>::scapegoatHeight(int nodes) {
+    return nodes > 1 ? static_cast<int>(std::floor(std::log(nodes) / std::log(1.5))) : 0;
+}
+
+// если новый узел оказался слишком глубоко, поднимаемся к корню и ищем "козла отпущения" -
+// первого предка, у которого один из детей больше 2/3 его поддерева, и перестраиваем его
+template<typename T, typename Augment>
+void BinaryTree<T, Augment>::rebalanceAfterInsert(int key) {
+    std::vector<Node*> path;
+    for (Node* node = root; node; node = key < node->key ? node->left : node->right) {
+        path.push_back(node);
+        if (node->key == key && !multimap) break; // в multimap новый узел - лист в конце этого пути
+    }
+    if (static_cast<int>(path.size()) - 1 <= scapegoatHeight(size)) return;
+
+    int childSize = 1;
+    for (int i = static_cast<int>(path.size()) - 2; i >= 0; --i) {
+        Node* node = path[i];
+        Node* sibling = node->left == path[i + 1] ? node->right : node->left;
+        int nodeSize = childSize + subtreeSize(sibling) + 1;
+        if (3 * childSize > 2 * nodeSize) {
+            Node* rebuilt = rebuildSubtree(node, nodeSize);
+            if (i == 0) root = rebuilt;
+            else if (path[i - 1]->left == node) path[i - 1]->left = rebuilt;
+            else path[i - 1]->right = rebuilt;
+            for (int j = i - 1; j >= 0; --j) pull(path[j]); // форма ниже изменилась - сводки предков тоже
+            depthStale = true;
+            return;
+        }
+        childSize = nodeSize;
+    }
+}
+
+// после удаления трети узлов с последней полной перестройки перестраиваем всё дерево
+template<typename T, typename Augment>
+void BinaryTree<T, Augment>::rebalanceAfterRemove() {
+    if (accessMode != AccessMode::Scapegoat || 3 * size >= 2 * maxSize) return;
+    root = rebuildSubtree(root, size);
+    maxSize = size;
+    cachedDepth = balancedDepth(size);
+    depthStale = false;
+}
+
+template<typename T, typename Augment>
+void BinaryTree<T, Augment>::collectNodes(Node* node, std::vector<Node*>& out) const {
+    if (!node) return;
+    if (threadedScans) {
+        morris(node, false, [&](Node* n) { out.push_back(n); });
+        return;
+    }
+    collectNodes(node->left, out);
+    out.push_back(node);
+    collectNodes(node->right, out);
+}
+
+// то же, что buildBalancedTree, но узлы переиспользуются
+template<typename T, typename Augment>
+typename BinaryTree<T, Augment>::Node* BinaryTree<T, Augment>::linkBalanced(const std::vector<Node*>& nodes, int start, int end) {
+    if (start > end) return nullptr;
+    int mid = (start + end) / 2;
+    Node* node = nodes[mid];
+    node->left = linkBalanced(nodes, start, mid - 1);
+    node->right = linkBalanced(nodes, mid + 1, end);
+    pull(node);
+    return node;
+}
+
+template<typename T, typename Augment>
+typename BinaryTree<T, Augment>::Node* BinaryTree<T, Augment>::rebuildSubtree(Node* node, int count) const {
+    std::vector<Node*> nodes;
+    nodes.reserve(count);
+    collectNodes(node, nodes);
+    return linkBalanced(nodes, 0, static_cast<int>(nodes.size()) - 1);
 }
 
-template<typename T>
-typename BinaryTree<T>::Node* BinaryTree<T>::search(Node* node, int key) const {
+template<typename T, typename Augment>
+typename BinaryTree<T, Augment>::Node* BinaryTree<T, Augment>::search(Node* node, int key) const {
+    if (multimap) { // самый ранний из равных - самый левый
+        Node* found = nullptr;
+        while (node) {
+            if (key == node->key) found = node;
+            node = key <= node->key ? node->left : node->right;
+        }
+        return found;
+    }
     if (!node) return nullptr;
     if (key == node->key) return node;
     if (key < node->key) return search(node->left, key);
     return search(node->right, key);
 }
 
-template<typename T>
-T* BinaryTree<T>::search(int key) const {
-    Node* res = search(root, key);
-    return res ? &res->value : nullptr;
+template<typename T, typename Augment>
+const T* BinaryTree<T, Augment>::search(int key) const {
+    if (keyFilter && !keyFilter->mayContain(key)) return nullptr;
+    Node* node = adaptive ? adaptiveSearch(key) : search(root, key);
+    return node ? &node->value : nullptr;
+}
+
+template<typename T, typename Augment>
+T* BinaryTree<T, Augment>::search(int key) {
+    if (accessMode != AccessMode::Splay) return expose(std::as_const(*this).search(key));
+    root = splay(root, key); // даже при промахе в корень поднимается ближайший ключ
+    depthStale = true;
+    if (!root || root->key != key) return nullptr;
+    return expose(&(multimap ? search(root, key) : root)->value);
 }
 
-template<typename T>
-typename BinaryTree<T>::Node* BinaryTree<T>::getMinNode(Node* node) const {
+// поднимает key (или последний узел на пути к нему) в корень поддерева - нисходящий splay за один
+// проход без рекурсии. Узлы левее пути собираются в левое дерево, правее - в правое; пока спуск
+// не закончен, свободная ссылка очередного узла (right у левого дерева, left у правого) хранит
+// предыдущий узел сборки, поэтому при склейке сводки пересчитываются снизу вверх ровно по разу
+template<typename T, typename Augment>
+typename BinaryTree<T, Augment>::Node* BinaryTree<T, Augment>::splay(Node* node, int key) {
+    if (!node) return nullptr;
+    Node* leftLast = nullptr;  // наибольший узел левого дерева
+    Node* rightLast = nullptr; // наименьший узел правого дерева
+    while (key != node->key) {
+        if (key < node->key) {
+            if (!node->left) break;
+            if (key < node->left->key) { // zig-zig: поворот вправо, поддерево бывшего корня уже окончательное
+                Node* pivot = node->left;
+                node->left = pivot->right;
+                pivot->right = node;
+                pull(node);
+                node = pivot;
+                if (!node->left) break;
+            }
+            Node* next = node->left;
+            node->left = rightLast;
+            rightLast = node;
+            node = next;
+        } else {
+            if (!node->right) break;
+            if (key > node->right->key) { // zig-zig: поворот влево
+                Node* pivot = node->right;
+                node->right = pivot->left;
+                pivot->left = node;
+                pull(node);
+                node = pivot;
+                if (!node->right) break;
+            }
+            Node* next = node->right;
+            node->right = leftLast;
+            leftLast = node;
+            node = next;
+        }
+    }
+    Node* left = node->left;
+    while (leftLast) {
+        Node* previous = leftLast->right;
+        leftLast->right = left;
+        pull(leftLast);
+        left = leftLast;
+        leftLast = previous;
+    }
+    Node* right = node->right;
+    while (rightLast) {
+        Node* previous = rightLast->left;
+        rightLast->left = right;
+        pull(rightLast);
+        right = rightLast;
+        rightLast = previous;
+    }
+    node->left = left;
+    node->right = right;
+    pull(node);
+    return node;
+}
+
+template<typename T, typename Augment>
+typename BinaryTree<T, Augment>::Node* BinaryTree<T, Augment>::getMinNode(Node* node) const {
     if (!node) return nullptr;
     while (node->left) node = node->left;
     return node;
 }
 
-template<typename T>
-typename BinaryTree<T>::Node* BinaryTree<T>::getMaxNode(Node* node) const {
+template<typename T, typename Augment>
+typename BinaryTree<T, Augment>::Node* BinaryTree<T, Augment>::getMaxNode(Node* node) const {
     if (!node) return nullptr;
     while (node->right) node = node->right;
     return node;
 }
 
-template<typename T>
-T BinaryTree<T>::getMin() const {
-    Node* min = getMinNode(root);
-    if (!min) throw Errors::TreeEmpty();
-    return min->value;
+template<typename T, typename Augment>
+T BinaryTree<T, Augment>::getMin() const {
+    return minRef();
 }
 
-template<typename T>
-T BinaryTree<T>::getMax() const {
-    Node* max = getMaxNode(root);
-    if (!max) throw Errors::TreeEmpty();
-    return max->value;
+template<typename T, typename Augment>
+T BinaryTree<T, Augment>::getMax() const {
+    return maxRef();
 }
 
-template<typename T>
-typename BinaryTree<T>::Node* BinaryTree<T>::remove(Node* node, int key, bool& success) {
+template<typename T, typename Augment>
+const T& BinaryTree<T, Augment>::minRef() const {
+    if (!minNode) throw Errors::TreeEmpty();
+    return minNode->value;
+}
+
+template<typename T, typename Augment>
+const T& BinaryTree<T, Augment>::maxRef() const {
+    if (!maxNode) throw Errors::TreeEmpty();
+    return maxNode->value;
+}
+
+// отцепляет крайний узел: у самого левого нет левого ребёнка, у самого правого - правого
+template<typename T, typename Augment>
+typename BinaryTree<T, Augment>::Node* BinaryTree<T, Augment>::unlinkExtreme(bool leftmost) {
+    if (!root) throw Errors::TreeEmpty();
+    std::vector<Node*> path; // предки крайнего узла, их сводки надо пересчитать
+    Node** link = &root;
+    while (leftmost ? (*link)->left : (*link)->right) {
+        path.push_back(*link);
+        link = leftmost ? &(*link)->left : &(*link)->right;
+    }
+    Node* node = *link;
+    *link = leftmost ? node->right : node->left;
+    for (auto it = path.rbegin(); it != path.rend(); ++it) pull(*it);
+
+    --size;
+    indexErase(node);
+    touch();
+    if (leftmost) minNode = getMinNode(*link ? *link : (path.empty() ? nullptr : path.back()));
+    else maxNode = getMaxNode(*link ? *link : (path.empty() ? nullptr : path.back()));
+    if (!root) minNode = maxNode = nullptr;
+    depthStale = true;
+    rebalanceAfterRemove();
+    return node;
+}
+
+template<typename T, typename Augment>
+T BinaryTree<T, Augment>::popMin() {
+    Node* node = unlinkExtreme(true);
+    T value = std::move(node->value);
+    delete node;
+    return value;
+}
+
+template<typename T, typename Augment>
+T BinaryTree<T, Augment>::popMax() {
+    Node* node = unlinkExtreme(false);
+    T value = std::move(node->value);
+    delete node;
+    return value;
+}
+
+template<typename T, typename Augment>
+typename BinaryTree<T, Augment>::Node* BinaryTree<T, Augment>::remove(Node* node, int key, bool& success) {
     if (!node) return nullptr;
     if (key < node->key)
         node->left = remove(node->left, key, success);
     else if (key > node->key)
         node->right = remove(node->right, key, success);
     else {
+        if (multimap) { // сначала более ранние повторы - они левее
+            node->left = remove(node->left, key, success);
+            if (success) {
+                pull(node);
+                return node;
+            }
+        }
         success = true;
         --size;
         if (!node->left) {
             Node* temp = node->right;
+            indexErase(node);
             delete node;
             return temp;
         }
         if (!node->right) {
             Node* temp = node->left;
+            indexErase(node);
             delete node;
             return temp;
         }
-        Node* minRight = getMinNode(node->right);
-        node->key = minRight->key;
-        node->value = minRight->value;
-        node->right = remove(node->right, minRight->key, success);
+        // преемник отцепляется тем же спуском и встаёт на место узла: значения не копируются
+        Node* successor = detachMin(node->right);
+        successor->left = node->left;
+        successor->right = node->right;
+        pull(successor);
+        indexErase(node);
+        delete node;
+        return successor;
     }
+    pull(node);
     return node;
 }
 
-template<typename T>
-bool BinaryTree<T>::remove(int key) {
+// отцепляет наименьший узел поддерева, его правый ребёнок занимает освободившееся место
+template<typename T, typename Augment>
+typename BinaryTree<T, Augment>::Node* BinaryTree<T, Augment>::detachMin(Node*& subtree) {
+    std::vector<Node*> path;
+    Node** link = &subtree;
+    while ((*link)->left) {
+        path.push_back(*link);
+        link = &(*link)->left;
+    }
+    Node* min = *link;
+    *link = min->right;
+    for (auto it = path.rbegin(); it != path.rend(); ++it) pull(*it);
+    return min;
+}
+
+template<typename T, typename Augment>
+bool BinaryTree<T, Augment>::remove(int key) {
     bool success = false;
+    bool extreme = root && (key == minNode->key || key == maxNode->key);
     root = remove(root, key, success);
+    if (success) { // узлы не пересоздаются, так что кеш меняется, только если удалён крайний
+        touch();
+        if (extreme) {
+            minNode = getMinNode(root);
+            maxNode = getMaxNode(root);
+        }
+        depthStale = true;
+        rebalanceAfterRemove();
+    }
     return success;
 }
 
-template<typename T>
-void BinaryTree<T>::traverse(Node* node, const std::string& order, std::function<void(const T&)> func) const {
+template<typename T, typename Augment>
+void BinaryTree<T, Augment>::traverse(Node* node, const std::string& order, std::function<void(const T&)> func) const {
     if (!node) return;
     if (order == "KLP") { func(node->value); traverse(node->left, order, func); traverse(node->right, order, func); }
     else if (order == "KPL") { func(node->value); traverse(node->right, order, func); traverse(node->left, order, func); }
@@ -231,13 +1300,13 @@ void BinaryTree<T>::traverse(Node* node, const std::string& order, std::function
     else throw Errors::UnknownOrder(order);
 }
 
-template<typename T>
-void BinaryTree<T>::traverse(std::function<void(int, const T&)> func) const {
+template<typename T, typename Augment>
+void BinaryTree<T, Augment>::traverse(std::function<void(int, const T&)> func) const {
     traverse(root, func);
 }
 
-template<typename T>
-void BinaryTree<T>::traverse(Node* node, std::function<void(int, const T&)> func) const {
+template<typename T, typename Augment>
+void BinaryTree<T, Augment>::traverse(Node* node, std::function<void(int, const T&)> func) const {
     if (!node) return;
     func(node->key, node->value);
     traverse(node->left, func);
@@ -245,32 +1314,162 @@ void BinaryTree<T>::traverse(Node* node, std::function<void(int, const T&)> func
 }
 
 
-template<typename T> void BinaryTree<T>::traverseKLP(std::function<void(const T&)> func) const { traverse(root, "KLP", func); }
-template<typename T> void BinaryTree<T>::traverseKPL(std::function<void(const T&)> func) const { traverse(root, "KPL", func); }
-template<typename T> void BinaryTree<T>::traverseLPK(std::function<void(const T&)> func) const { traverse(root, "LPK", func); }
-template<typename T> void BinaryTree<T>::traverseLKP(std::function<void(const T&)> func) const { traverse(root, "LKP", func); }
-template<typename T> void BinaryTree<T>::traversePLK(std::function<void(const T&)> func) const { traverse(root, "PLK", func); }
-template<typename T> void BinaryTree<T>::traversePKL(std::function<void(const T&)> func) const { traverse(root, "PKL", func); }
+template<typename T, typename Augment> void BinaryTree<T, Augment>::traverseKLP(std::function<void(const T&)> func) const { traverse(root, "KLP", func); }
+template<typename T, typename Augment> void BinaryTree<T, Augment>::traverseKPL(std::function<void(const T&)> func) const { traverse(root, "KPL", func); }
+template<typename T, typename Augment> void BinaryTree<T, Augment>::traverseLPK(std::function<void(const T&)> func) const { traverse(root, "LPK", func); }
+template<typename T, typename Augment> void BinaryTree<T, Augment>::traverseLKP(std::function<void(const T&)> func) const {
+    if (threadedScans) morris(root, false, [&](Node* node) { func(node->value); });
+    else traverse(root, "LKP", func);
+}
+template<typename T, typename Augment>
+typename BinaryTree<T, Augment>::const_iterator BinaryTree<T, Augment>::begin() const {
+    return const_iterator(root);
+}
+
+template<typename T, typename Augment>
+typename BinaryTree<T, Augment>::const_iterator BinaryTree<T, Augment>::end() const {
+    return const_iterator();
+}
+
+// в стеке остаются узлы, от которых спуск ушёл влево, - ровно те, к которым итератор ещё вернётся
+template<typename T, typename Augment>
+typename BinaryTree<T, Augment>::const_iterator BinaryTree<T, Augment>::lowerBound(int key) const {
+    const_iterator it;
+    for (Node* node = root; node; node = node->key >= key ? node->left : node->right)
+        if (node->key >= key) it.stack.push_back(node);
+    return it;
+}
+
+template<typename T, typename Augment>
+typename BinaryTree<T, Augment>::const_iterator BinaryTree<T, Augment>::upperBound(int key) const {
+    const_iterator it;
+    for (Node* node = root; node; node = node->key > key ? node->left : node->right)
+        if (node->key > key) it.stack.push_back(node);
+    return it;
+}
+
+template<typename T, typename Augment>
+std::pair<typename BinaryTree<T, Augment>::const_iterator, typename BinaryTree<T, Augment>::const_iterator>
+BinaryTree<T, Augment>::equalRange(int key) const {
+    return {lowerBound(key), upperBound(key)};
+}
 
-template<typename T>
-BinaryTree<T> BinaryTree<T>::map(std::function<T(const T&)> f) const {
-    BinaryTree<T> result;
-    traverseKLP([&](const T& val) { result.insert(val, f(val)); });
+template<typename T, typename Augment>
+int BinaryTree<T, Augment>::count(int key) const {
+    auto [first, last] = equalRange(key);
+    return static_cast<int>(std::distance(first, last));
+}
+
+template<typename T, typename Augment> void BinaryTree<T, Augment>::traversePLK(std::function<void(const T&)> func) const { traverse(root, "PLK", func); }
+template<typename T, typename Augment> void BinaryTree<T, Augment>::traversePKL(std::function<void(const T&)> func) const {
+    if (threadedScans) morris(root, true, [&](Node* node) { func(node->value); });
+    else traverse(root, "PKL", func);
+}
+
+template<typename T, typename Augment>
+int BinaryTree<T, Augment>::forkDepth(int nodes) {
+    unsigned threads = ThreadPool::Instance().Size();
+    if (threads <= 1 || nodes < kParallelCutoff) return 0;
+    int depth = 2; // с запасом, чтобы потоки не простаивали на неровных поддеревьях
+    while ((1u << (depth - 2)) < threads) ++depth;
+    return depth;
+}
+
+template<typename T, typename Augment>
+typename BinaryTree<T, Augment>::Node* BinaryTree<T, Augment>::mapNode(Node* node, const std::function<T(const T&)>& f, int depth) const {
+    if (!node) return nullptr;
+    Node* newNode = new Node(node->key, f(node->value));
+    if (depth > 0) { // левое и правое поддеревья независимы - считаем их параллельно
+        ThreadPool::Instance().Invoke(
+            [&] { newNode->left = mapNode(node->left, f, depth - 1); },
+            [&] { newNode->right = mapNode(node->right, f, depth - 1); });
+    } else {
+        newNode->left = mapNode(node->left, f, 0);
+        newNode->right = mapNode(node->right, f, 0);
+    }
+    pull(newNode);
+    return newNode;
+}
+
+template<typename T, typename Augment>
+void BinaryTree<T, Augment>::filterCollect(Node* node, const std::function<bool(const T&)>& p,
+                                  std::vector<std::pair<int, T>>& out, int depth) const {
+    if (!node) return;
+    if (depth > 0) {
+        std::vector<std::pair<int, T>> right; // правая часть собирается отдельно и дописывается в конец
+        ThreadPool::Instance().Invoke(
+            [&] { filterCollect(node->left, p, out, depth - 1); },
+            [&] { filterCollect(node->right, p, right, depth - 1); });
+        if (p(node->value)) out.push_back({node->key, node->value});
+        out.insert(out.end(), std::make_move_iterator(right.begin()), std::make_move_iterator(right.end()));
+    } else {
+        filterCollect(node->left, p, out, 0);
+        if (p(node->value)) out.push_back({node->key, node->value});
+        filterCollect(node->right, p, out, 0);
+    }
+}
+
+// f и p могут вызываться из нескольких потоков одновременно
+template<typename T, typename Augment>
+BinaryTree<T, Augment> BinaryTree<T, Augment>::map(std::function<T(const T&)> f) const {
+    BinaryTree<T, Augment> result;
+    result.multimap = multimap;
+    result.root = mapNode(root, f, forkDepth(size)); // форма и ключи те же, меняются только значения
+    result.size = size;
+    result.rebuildIndexes();
+    result.cachedDepth = cachedDepth;
+    result.depthStale = depthStale;
     return result;
 }
 
-template<typename T>
-BinaryTree<T> BinaryTree<T>::where(std::function<bool(const T&)> p) const {
-    BinaryTree<T> result;
-    traverseKLP([&](const T& val) {
-        if (p(val)) result.insert(val, val);
-    });
+template<typename T, typename Augment>
+BinaryTree<T, Augment> BinaryTree<T, Augment>::where(std::function<bool(const T&)> p) const {
+    std::vector<std::pair<int, T>> nodes; // отфильтрованные узлы уже отсортированы по ключу
+    filterCollect(root, p, nodes, forkDepth(size));
+    BinaryTree<T, Augment> result;
+    result.multimap = multimap;
+    result.root = result.buildBalancedTree(nodes, 0, static_cast<int>(nodes.size()) - 1, forkDepth(static_cast<int>(nodes.size())));
+    result.size = static_cast<int>(nodes.size());
+    result.rebuildIndexes();
+    result.cachedDepth = balancedDepth(result.size);
+    result.depthStale = false;
     return result;
 }
 
-template<typename T>
-BinaryTree<T> BinaryTree<T>::merge(const BinaryTree<T>& other) const {
-    BinaryTree<T> result;
+template<typename T, typename Augment>
+template<typename R, typename ReduceOp, typename TransformOp>
+void BinaryTree<T, Augment>::accumulate(Node* node, R& acc, const R& identity, ReduceOp& reduce, TransformOp& transform, int depth) const {
+    if (!node) return;
+    if (depth > 0) {
+        R right = identity; // правое поддерево копит отдельно, потом приклеиваем справа
+        ThreadPool::Instance().Invoke(
+            [&] { accumulate(node->left, acc, identity, reduce, transform, depth - 1); },
+            [&] { accumulate(node->right, right, identity, reduce, transform, depth - 1); });
+        acc = reduce(acc, transform(node->value));
+        acc = reduce(acc, right);
+    } else {
+        accumulate(node->left, acc, identity, reduce, transform, 0);
+        acc = reduce(acc, transform(node->value));
+        accumulate(node->right, acc, identity, reduce, transform, 0);
+    }
+}
+
+template<typename T, typename Augment>
+template<typename R, typename ReduceOp, typename TransformOp>
+R BinaryTree<T, Augment>::transformReduce(R identity, ReduceOp reduce, TransformOp transform) const {
+    R acc = identity;
+    accumulate(root, acc, identity, reduce, transform, forkDepth(size));
+    return acc;
+}
+
+template<typename T, typename Augment>
+T BinaryTree<T, Augment>::reduce(T identity, std::function<T(const T&, const T&)> op) const {
+    return transformReduce(identity, op, [](const T& value) -> const T& { return value; });
+}
+
+template<typename T, typename Augment>
+BinaryTree<T, Augment> BinaryTree<T, Augment>::merge(const BinaryTree<T, Augment>& other) const {
+    BinaryTree<T, Augment> result;
     traverse([&result](int key, const T& val) { // обходим по первому дереву(нет прямого доступа к ключу, поэтому используем traverse)
         result.insert(key, val);
     });
@@ -282,52 +1481,442 @@ BinaryTree<T> BinaryTree<T>::merge(const BinaryTree<T>& other) const {
 }
 
 
-template<typename T>
-typename BinaryTree<T>::Node* BinaryTree<T>::copy(Node* node) const {
+template<typename T, typename Augment>
+typename BinaryTree<T, Augment>::Node* BinaryTree<T, Augment>::splitNode(Node* node, int key, Node*& left, Node*& right) {
+    if (!node) {
+        left = right = nullptr;
+        return nullptr;
+    }
+    if (node->key == key) {
+        left = node->left;
+        right = node->right;
+        node->left = node->right = nullptr;
+        pull(node);
+        return node;
+    }
+    Node* found;
+    if (node->key < key) {
+        found = splitNode(node->right, key, node->right, right);
+        left = node;
+    } else {
+        found = splitNode(node->left, key, left, node->left);
+        right = node;
+    }
+    pull(node);
+    return found;
+}
+
+// в отличие от splitNode, равные key целиком уходят вправо - годится и для повторяющихся ключей
+template<typename T, typename Augment>
+void BinaryTree<T, Augment>::splitLess(Node* node, int key, Node*& left, Node*& right) {
+    if (!node) {
+        left = right = nullptr;
+        return;
+    }
+    if (node->key < key) {
+        splitLess(node->right, key, node->right, right);
+        left = node;
+    } else {
+        splitLess(node->left, key, left, node->left);
+        right = node;
+    }
+    pull(node);
+}
+
+// корнем становится максимум левого дерева
+template<typename T, typename Augment>
+typename BinaryTree<T, Augment>::Node* BinaryTree<T, Augment>::joinNodes(Node* left, Node* right) {
+    if (!left) return right;
+    if (!right) return left;
+    std::vector<Node*> path;
+    Node** link = &left;
+    while ((*link)->right) {
+        path.push_back(*link);
+        link = &(*link)->right;
+    }
+    Node* mid = *link;
+    *link = mid->left;
+    for (auto it = path.rbegin(); it != path.rend(); ++it) pull(*it);
+    mid->left = left;
+    mid->right = right;
+    pull(mid);
+    return mid;
+}
+
+// корень b делит a на две части, половины объединяются параллельно
+template<typename T, typename Augment>
+typename BinaryTree<T, Augment>::Node* BinaryTree<T, Augment>::unionNodes(Node* a, Node* b, int depth) {
+    if (!a) return b;
+    if (!b) return a;
+    Node *aLeft, *aRight;
+    delete splitNode(a, b->key, aLeft, aRight); // узел с тем же ключом вытесняется узлом b
+    Node *bLeft = b->left, *bRight = b->right;
+    if (depth > 0) {
+        ThreadPool::Instance().Invoke(
+            [&] { b->left = unionNodes(aLeft, bLeft, depth - 1); },
+            [&] { b->right = unionNodes(aRight, bRight, depth - 1); });
+    } else {
+        b->left = unionNodes(aLeft, bLeft, 0);
+        b->right = unionNodes(aRight, bRight, 0);
+    }
+    pull(b);
+    return b;
+}
+
+template<typename T, typename Augment>
+typename BinaryTree<T, Augment>::Node* BinaryTree<T, Augment>::intersectNodes(Node* a, Node* b, int depth) {
+    if (!a || !b) {
+        destroy(a);
+        destroy(b);
+        return nullptr;
+    }
+    Node *bLeft, *bRight;
+    Node* found = splitNode(b, a->key, bLeft, bRight);
+    Node *left = nullptr, *right = nullptr;
+    if (depth > 0) {
+        ThreadPool::Instance().Invoke(
+            [&] { left = intersectNodes(a->left, bLeft, depth - 1); },
+            [&] { right = intersectNodes(a->right, bRight, depth - 1); });
+    } else {
+        left = intersectNodes(a->left, bLeft, 0);
+        right = intersectNodes(a->right, bRight, 0);
+    }
+    if (!found) {
+        delete a;
+        return joinNodes(left, right);
+    }
+    delete found;
+    a->left = left;
+    a->right = right;
+    pull(a);
+    return a;
+}
+
+template<typename T, typename Augment>
+typename BinaryTree<T, Augment>::Node* BinaryTree<T, Augment>::differenceNodes(Node* a, Node* b, int depth) {
+    if (!a || !b) {
+        destroy(b);
+        return a;
+    }
+    Node *bLeft, *bRight;
+    Node* found = splitNode(b, a->key, bLeft, bRight);
+    Node *left = nullptr, *right = nullptr;
+    if (depth > 0) {
+        ThreadPool::Instance().Invoke(
+            [&] { left = differenceNodes(a->left, bLeft, depth - 1); },
+            [&] { right = differenceNodes(a->right, bRight, depth - 1); });
+    } else {
+        left = differenceNodes(a->left, bLeft, 0);
+        right = differenceNodes(a->right, bRight, 0);
+    }
+    if (found) {
+        delete found;
+        delete a;
+        return joinNodes(left, right);
+    }
+    a->left = left;
+    a->right = right;
+    pull(a);
+    return a;
+}
+
+template<typename T, typename Augment>
+int BinaryTree<T, Augment>::eraseRange(int lo, int hi) {
+    if (lo > hi) return 0;
+    Node* hit = root; // пустой диапазон не трогает форму дерева
+    while (hit && (hit->key < lo || hit->key > hi)) hit = hit->key < lo ? hit->right : hit->left;
+    if (!hit) return 0;
+
+    Node *left, *middle, *right = nullptr;
+    splitLess(root, lo, left, middle);
+    if (hi < std::numeric_limits<int>::max()) splitLess(middle, hi + 1, middle, right);
+    root = joinNodes(left, right);
+
+    int erased = kCounted ? subtreeSize(middle) : 0;
+    if (!kCounted || valueIndex) { // один проход по вырезанному куску: подсчёт и чистка индекса
+        std::vector<Node*> stack{middle};
+        while (!stack.empty()) {
+            Node* node = stack.back();
+            stack.pop_back();
+            if (!kCounted) ++erased;
+            indexErase(node);
+            if (node->left) stack.push_back(node->left);
+            if (node->right) stack.push_back(node->right);
+        }
+    }
+    dispose(middle, erased);
+
+    size -= erased;
+    touch();
+    minNode = getMinNode(root);
+    maxNode = getMaxNode(root);
+    depthStale = true;
+    rebalanceAfterRemove();
+    restoreScapegoatBound(); // склейка могла углубить дерево и без заметного уменьшения размера
+    return erased;
+}
+
+// выжившие узлы перецепляются, на месте удалённого - склейка его поддеревьев
+template<typename T, typename Augment>
+typename BinaryTree<T, Augment>::Node* BinaryTree<T, Augment>::eraseIf(Node* node, const std::function<bool(const T&)>& pred, int& erased, int depth) {
+    if (!node) return nullptr;
+    int leftErased = 0, rightErased = 0;
+    Node *left = nullptr, *right = nullptr;
+    if (depth > 0) {
+        ThreadPool::Instance().Invoke(
+            [&] { left = eraseIf(node->left, pred, leftErased, depth - 1); },
+            [&] { right = eraseIf(node->right, pred, rightErased, depth - 1); });
+    } else {
+        left = eraseIf(node->left, pred, leftErased, 0);
+        right = eraseIf(node->right, pred, rightErased, 0);
+    }
+    erased += leftErased + rightErased;
+    if (pred(node->value)) {
+        ++erased;
+        delete node;
+        return joinNodes(left, right);
+    }
+    node->left = left;
+    node->right = right;
+    pull(node);
+    return node;
+}
+
+template<typename T, typename Augment>
+int BinaryTree<T, Augment>::eraseIf(std::function<bool(const T&)> pred) {
+    int erased = 0;
+    root = eraseIf(root, pred, erased, forkDepth(size));
+    if (erased == 0) return 0;
+    size -= erased;
+    int peak = maxSize;
+    rebuildIndexes(); // индекс правится целиком: узлы удалялись из разных потоков
+    maxSize = peak;
+    rebalanceAfterRemove();
+    return erased;
+}
+
+// размер левой части берётся из сводки CountAugment или считается обходом, правая - остаток;
+// в режиме Scapegoat части ещё проверяются на границу глубины
+template<typename T, typename Augment>
+std::pair<BinaryTree<T, Augment>, BinaryTree<T, Augment>> BinaryTree<T, Augment>::split(int key) {
+    std::pair<BinaryTree<T, Augment>, BinaryTree<T, Augment>> parts;
+    for (BinaryTree<T, Augment>* part : {&parts.first, &parts.second}) { // настройки переходят к обеим частям
+        part->deferredDestroy = deferredDestroy;
+        part->accessMode = accessMode;
+        part->multimap = multimap;
+        part->hashesStale = hashesStale;
+        if (valueIndex) part->valueIndex = std::make_unique<ValueIndex>();
+    }
+    int total = size;
+    Node *left, *right;
+    splitLess(detach(), key, left, right);
+    int leftSize = subtreeSize(left, forkDepth(total));
+    parts.first.adopt(left, leftSize);
+    parts.second.adopt(right, total - leftSize);
+    parts.first.restoreScapegoatBound();
+    parts.second.restoreScapegoatBound();
+    return parts;
+}
+
+template<typename T, typename Augment>
+BinaryTree<T, Augment> BinaryTree<T, Augment>::join(BinaryTree<T, Augment>&& left, BinaryTree<T, Augment>&& right) {
+    bool multimap = left.multimap && right.multimap; // мультиотображения могут стыковаться равными ключами
+    if (left.root && right.root && (left.maxNode->key > right.minNode->key || (!multimap && left.maxNode->key == right.minNode->key)))
+        throw Errors::InvalidArgument("key ranges of joined trees overlap");
+    BinaryTree<T, Augment> result;
+    result.deferredDestroy = left.deferredDestroy;
+    result.accessMode = left.accessMode;
+    result.multimap = left.multimap || right.multimap;
+    result.hashesStale = left.hashesStale || right.hashesStale;
+    if (left.valueIndex) result.valueIndex = std::make_unique<ValueIndex>();
+    int count = left.size + right.size;
+    Node* l = left.detach();
+    result.adopt(joinNodes(l, right.detach()), count);
+    result.restoreScapegoatBound();
+    return result;
+}
+
+template<typename T, typename Augment>
+BinaryTree<T, Augment> BinaryTree<T, Augment>::setOperation(const BinaryTree<T, Augment>& other, SetOp op) const {
+    if (multimap || other.multimap) throw Errors::InvalidArgument("set operations need unique keys");
+    int depth = forkDepth(size + other.size);
+    Node *a = copy(root, depth), *b = copy(other.root, depth);
+    return adoptSetResult(op(a, b, depth), depth, hashesStale || other.hashesStale); // узлы копируются вместе с хешами
+}
+
+template<typename T, typename Augment>
+BinaryTree<T, Augment> BinaryTree<T, Augment>::setOperation(BinaryTree<T, Augment>&& a, BinaryTree<T, Augment>&& b, SetOp op) {
+    if (a.multimap || b.multimap) throw Errors::InvalidArgument("set operations need unique keys");
+    int depth = forkDepth(a.size + b.size);
+    bool stale = a.hashesStale || b.hashesStale; // устаревшие хеши уходят вместе с узлами
+    Node* l = a.detach();
+    Node* r = b.detach();
+    return adoptSetResult(op(l, r, depth), depth, stale);
+}
+
+template<typename T, typename Augment>
+BinaryTree<T, Augment> BinaryTree<T, Augment>::adoptSetResult(Node* node, int depth, bool hashesStale) {
+    BinaryTree<T, Augment> result;
+    result.hashesStale = hashesStale;
+    result.adopt(node, subtreeSize(node, depth));
+    return result;
+}
+
+template<typename T, typename Augment>
+BinaryTree<T, Augment> BinaryTree<T, Augment>::unionWith(const BinaryTree<T, Augment>& other) const {
+    return setOperation(other, unionNodes);
+}
+
+template<typename T, typename Augment>
+BinaryTree<T, Augment> BinaryTree<T, Augment>::intersect(const BinaryTree<T, Augment>& other) const {
+    return setOperation(other, intersectNodes);
+}
+
+template<typename T, typename Augment>
+BinaryTree<T, Augment> BinaryTree<T, Augment>::difference(const BinaryTree<T, Augment>& other) const {
+    return setOperation(other, differenceNodes);
+}
+
+template<typename T, typename Augment>
+BinaryTree<T, Augment> BinaryTree<T, Augment>::unionWith(BinaryTree<T, Augment>&& a, BinaryTree<T, Augment>&& b) {
+    return setOperation(std::move(a), std::move(b), unionNodes);
+}
+
+template<typename T, typename Augment>
+BinaryTree<T, Augment> BinaryTree<T, Augment>::intersect(BinaryTree<T, Augment>&& a, BinaryTree<T, Augment>&& b) {
+    return setOperation(std::move(a), std::move(b), intersectNodes);
+}
+
+template<typename T, typename Augment>
+BinaryTree<T, Augment> BinaryTree<T, Augment>::difference(BinaryTree<T, Augment>&& a, BinaryTree<T, Augment>&& b) {
+    return setOperation(std::move(a), std::move(b), differenceNodes);
+}
+
+template<typename T, typename Augment>
+typename BinaryTree<T, Augment>::Node* BinaryTree<T, Augment>::copy(Node* node, int depth) const {
     if (!node) return nullptr;
     Node* newNode = new Node(node->key, node->value);
+    newNode->augment() = node->augment();
+    if (depth > 0) {
+        ThreadPool::Instance().Invoke(
+            [&] { newNode->left = copy(node->left, depth - 1); },
+            [&] { newNode->right = copy(node->right, depth - 1); });
+        return newNode;
+    }
     newNode->left = copy(node->left);
     newNode->right = copy(node->right);
     return newNode;
 }
 
-template<typename T>
-BinaryTree<T> BinaryTree<T>::extractSubtree(int key) const {
+template<typename T, typename Augment>
+BinaryTree<T, Augment> BinaryTree<T, Augment>::extractSubtree(int key) const {
     Node* found = search(root, key);
     if (!found) throw Errors::KeyNotFound();
-    BinaryTree<T> result;
-    result.root = copy(found);
+    BinaryTree<T, Augment> result;
+    result.multimap = multimap;
+    result.hashesStale = hashesStale;
+    result.size = subtreeSize(found);
+    result.root = copy(found, forkDepth(result.size));
+    result.rebuildIndexes();
     return result;
 }
 
-template<typename T>
-bool BinaryTree<T>::equals(Node* a, Node* b) const {
+template<typename T, typename Augment>
+bool BinaryTree<T, Augment>::equals(Node* a, Node* b, int depth) const {
     if (!a && !b) return true;
     if (!a || !b) return false;
-    return a->value == b->value &&
-           equals(a->left, b->left) &&
+    if (!(a->value == b->value)) return false;
+    if (depth > 0) {
+        bool left = false, right = false;
+        ThreadPool::Instance().Invoke(
+            [&] { left = equals(a->left, b->left, depth - 1); },
+            [&] { right = equals(a->right, b->right, depth - 1); });
+        return left && right;
+    }
+    return equals(a->left, b->left) &&
            equals(a->right, b->right);
 }
 
-template<typename T>
-bool BinaryTree<T>::containsSubtree(Node* root, Node* sub) const {
-    if (!root) return false;
-    if (equals(root, sub)) return true;
-    return containsSubtree(root->left, sub) || containsSubtree(root->right, sub);
+// в левое поддерево спускаемся, только если там есть конец >= lo; вправо - только если key <= hi
+template<typename T, typename Augment>
+void BinaryTree<T, Augment>::overlapping(Node* node, int lo, int hi, std::vector<std::pair<int, T>>& out) const {
+    if (!node || node->augment() < lo) return;
+    overlapping(node->left, lo, hi, out);
+    if (node->key > hi) return;
+    if (Augment::make(node->key, node->value) >= lo) out.emplace_back(node->key, node->value);
+    overlapping(node->right, lo, hi, out);
+}
+
+template<typename T, typename Augment>
+std::vector<std::pair<int, T>> BinaryTree<T, Augment>::overlapping(int lo, int hi) const {
+    static_assert(IsMaxEndpoint<Augment>::value, "overlapping needs BinaryTree<T, MaxEndpoint<EndOf>>");
+    std::vector<std::pair<int, T>> out;
+    if (lo <= hi) overlapping(root, lo, hi, out);
+    return out;
 }
 
-template<typename T>
-bool BinaryTree<T>::containsSubtree(const BinaryTree<T>& sub) const {
-    return containsSubtree(root, sub.root);
+// путь к lo: узел с key >= lo вместе с правым поддеревом лежит в диапазоне и стоит левее
+// уже собранного, поэтому добавляется спереди
+template<typename T, typename Augment>
+typename BinaryTree<T, Augment>::Summary BinaryTree<T, Augment>::suffixSummary(Node* node, int lo) {
+    Summary acc;
+    for (; node; node = node->key < lo ? node->right : node->left) {
+        if (node->key < lo) continue;
+        typename Augment::Data part = Augment::make(node->key, node->value);
+        if (node->right) part = Augment::combine(part, node->right->augment());
+        acc = acc ? Augment::combine(part, *acc) : part;
+    }
+    return acc;
 }
 
-template<typename T>
-bool BinaryTree<T>::containsNode(const T& value) const {
-    return find(root, value) != nullptr;
+template<typename T, typename Augment>
+typename BinaryTree<T, Augment>::Summary BinaryTree<T, Augment>::prefixSummary(Node* node, int hi) {
+    Summary acc;
+    for (; node; node = node->key > hi ? node->left : node->right) {
+        if (node->key > hi) continue;
+        typename Augment::Data part = Augment::make(node->key, node->value);
+        if (node->left) part = Augment::combine(node->left->augment(), part);
+        acc = acc ? Augment::combine(*acc, part) : part;
+    }
+    return acc;
 }
 
-template<typename T>
-typename BinaryTree<T>::Node* BinaryTree<T>::find(Node* node, const T& value) const {
+// спуск до первого узла внутри [lo, hi]; дальше диапазон - суффикс его левого поддерева,
+// сам узел и префикс правого
+template<typename T, typename Augment>
+std::optional<typename Augment::Data> BinaryTree<T, Augment>::aggregate(int lo, int hi) const {
+    static_assert(!std::is_same<Augment, NoAugment>::value, "aggregate needs an augmented BinaryTree<T, Augment>");
+    if (lo > hi) return std::nullopt;
+    Node* node = root;
+    while (node && (node->key < lo || node->key > hi)) node = node->key < lo ? node->right : node->left;
+    if (!node) return std::nullopt;
+
+    typename Augment::Data result = Augment::make(node->key, node->value);
+    if (Summary left = suffixSummary(node->left, lo)) result = Augment::combine(*left, result);
+    if (Summary right = prefixSummary(node->right, hi)) result = Augment::combine(result, *right);
+    return result;
+}
+
+template<typename T, typename Augment>
+bool BinaryTree<T, Augment>::containsSubtree(Node* root, Node* sub, bool trustHashes) const {
+    if (!root || !sub) return false;
+    // при верных хешах полное сравнение только при их совпадении
+    if ((!trustHashes || subtreeHash(root) == subtreeHash(sub)) && equals(root, sub)) return true;
+    return containsSubtree(root->left, sub, trustHashes) || containsSubtree(root->right, sub, trustHashes);
+}
+
+template<typename T, typename Augment>
+bool BinaryTree<T, Augment>::containsSubtree(const BinaryTree<T, Augment>& sub) const {
+    return containsSubtree(root, sub.root, kHashed && !hashesStale && !sub.hashesStale);
+}
+
+template<typename T, typename Augment>
+bool BinaryTree<T, Augment>::containsNode(const T& value) const {
+    return lookup(value) != nullptr;
+}
+
+template<typename T, typename Augment>
+typename BinaryTree<T, Augment>::Node* BinaryTree<T, Augment>::find(Node* node, const T& value) const {
     if (!node) return nullptr;
     if (node->value == value) return node;
     Node* l = find(node->left, value);
@@ -335,13 +1924,13 @@ typename BinaryTree<T>::Node* BinaryTree<T>::find(Node* node, const T& value) co
     return find(node->right, value);
 }
 
-template<typename T>
-std::string BinaryTree<T>::toString() const {
+template<typename T, typename Augment>
+std::string BinaryTree<T, Augment>::toString() const {
     return serializeNode(root);
 }
 
-template<typename T>
-std::string BinaryTree<T>::serializeNode(Node* node) const {
+template<typename T, typename Augment>
+std::string BinaryTree<T, Augment>::serializeNode(Node* node) const {
     if (!node) return "()"; // Пустое поддерево
 
     std::ostringstream out;
@@ -362,8 +1951,8 @@ std::string BinaryTree<T>::serializeNode(Node* node) const {
     return out.str();
 }
 
-template<typename T>
-bool BinaryTree<T>::isValidTreeString(const std::string& s) {
+template<typename T, typename Augment>
+bool BinaryTree<T, Augment>::isValidTreeString(const std::string& s) {
     size_t pos = 0;
     try {
         Node* node = parseNode(s, pos);
@@ -378,8 +1967,8 @@ bool BinaryTree<T>::isValidTreeString(const std::string& s) {
     }
 }
 
-template<typename T>
-bool BinaryTree<T>::isValidBST(Node* node, const int* minKey, const int* maxKey) const {
+template<typename T, typename Augment>
+bool BinaryTree<T, Augment>::isValidBST(Node* node, const int* minKey, const int* maxKey) const {
     if (!node) return true;
 
     if ((minKey && node->key <= *minKey) || (maxKey && node->key >= *maxKey))
@@ -391,22 +1980,24 @@ bool BinaryTree<T>::isValidBST(Node* node, const int* minKey, const int* maxKey)
 
 
 
-template<typename T>
-BinaryTree<T> BinaryTree<T>::fromString(const std::string& str) {
+template<typename T, typename Augment>
+BinaryTree<T, Augment> BinaryTree<T, Augment>::fromString(const std::string& str) {
     size_t pos = 0;
-    BinaryTree<T> tree;
+    BinaryTree<T, Augment> tree;
 
     if (!tree.isValidTreeString(str)) {
         throw Errors::ParseError("Invalid tree string: structure or BST property violated.");
     }
 
     tree.root = tree.parseNode(str, pos);
+    tree.size = subtreeSize(tree.root);
+    tree.rebuildIndexes();
     return tree;
 }
 
 
-template<typename T>
-typename BinaryTree<T>::Node* BinaryTree<T>::parseNode(const std::string& s, size_t& pos) {
+template<typename T, typename Augment>
+typename BinaryTree<T, Augment>::Node* BinaryTree<T, Augment>::parseNode(const std::string& s, size_t& pos) {
 /* 
 (())5:5(())6:6()))
 (())5:5()))
@@ -447,13 +2038,14 @@ typename BinaryTree<T>::Node* BinaryTree<T>::parseNode(const std::string& s, siz
     Node* node = new Node(key, value);
     node->left  = left;
     node->right = right;
+    pull(node);
     return node;
 }
 
 
 
-template<typename T>
-T* BinaryTree<T>::findByPath(const std::string& path) const {
+template<typename T, typename Augment>
+const T* BinaryTree<T, Augment>::findByPath(const std::string& path) const {
     Node* node = root;
     for (char c : path) {
         if (!node) return nullptr;
@@ -464,9 +2056,14 @@ T* BinaryTree<T>::findByPath(const std::string& path) const {
     return node ? &node->value : nullptr;
 }
 
-template<typename T>
-T* BinaryTree<T>::findByRelativePath(const std::string& path, const T& from) const {
-    Node* node = find(root, from);
+template<typename T, typename Augment>
+T* BinaryTree<T, Augment>::findByPath(const std::string& path) {
+    return expose(std::as_const(*this).findByPath(path));
+}
+
+template<typename T, typename Augment>
+const T* BinaryTree<T, Augment>::findByRelativePath(const std::string& path, const T& from) const {
+    Node* node = lookup(from);
     if (!node) return nullptr;
     for (char c : path) {
         if (!node) return nullptr;
@@ -477,61 +2074,322 @@ T* BinaryTree<T>::findByRelativePath(const std::string& path, const T& from) con
     return node ? &node->value : nullptr;
 }
 
-template<typename T>
-typename BinaryTree<T>::Node* BinaryTree<T>::buildBalancedTree(const std::vector<std::pair<int, T>>& nodes, int start, int end) {
+template<typename T, typename Augment>
+T* BinaryTree<T, Augment>::findByRelativePath(const std::string& path, const T& from) {
+    return expose(std::as_const(*this).findByRelativePath(path, from));
+}
+
+template<typename T, typename Augment>
+typename BinaryTree<T, Augment>::Node* BinaryTree<T, Augment>::buildBalancedTree(const std::vector<std::pair<int, T>>& nodes, int start, int end, int depth) {
     if (start > end) return nullptr;
     int mid = (start + end) / 2; // среднее м-у стартом и концом
     Node* node = new Node(nodes[mid].first, nodes[mid].second); // берется из словаря nodes средний нод и его ключ(first) и значение (second), которые потом в новый нод идут
+    if (depth > 0) { // половины массива не пересекаются - строим их в разных потоках
+        ThreadPool::Instance().Invoke(
+            [&] { node->left = buildBalancedTree(nodes, start, mid - 1, depth - 1); },
+            [&] { node->right = buildBalancedTree(nodes, mid + 1, end, depth - 1); });
+        pull(node);
+        return node;
+    }
     node->left = buildBalancedTree(nodes, start, mid - 1); // рекурсивно создаем узел для середины слева
     node->right = buildBalancedTree(nodes, mid + 1, end); // рекурсивно создаем для середины справа
+    pull(node);
     return node; // возвращаем узел тогда, когда у нас  не осталось возможных потомков (старт > енд)
 }
 
-template<typename T>
-void BinaryTree<T>::inOrderCollect(Node* node, std::vector<std::pair<int, T>>& out) const {
+// устойчивая сортировка слиянием по ключу: половины сортируются параллельно, затем сливаются
+template<typename T, typename Augment>
+void BinaryTree<T, Augment>::sortByKey(std::vector<std::pair<int, T>>& items, size_t start, size_t end, int depth) {
+    auto byKey = [](const std::pair<int, T>& a, const std::pair<int, T>& b) { return a.first < b.first; };
+    if (depth <= 0 || end - start < 2) {
+        std::stable_sort(items.begin() + start, items.begin() + end, byKey);
+        return;
+    }
+    size_t mid = start + (end - start) / 2;
+    ThreadPool::Instance().Invoke(
+        [&] { sortByKey(items, start, mid, depth - 1); },
+        [&] { sortByKey(items, mid, end, depth - 1); });
+    std::inplace_merge(items.begin() + start, items.begin() + mid, items.begin() + end, byKey);
+}
+
+template<typename T, typename Augment>
+template<typename InputIt>
+void BinaryTree<T, Augment>::bulkLoad(InputIt first, InputIt last) {
+    std::vector<std::pair<int, T>> items;
+    inOrderCollect(root, items, forkDepth(size)); // старые значения идут первыми, чтобы новые их перезаписали
+    for (; first != last; ++first)
+        items.emplace_back(first->first, first->second);
+
+    int depth = forkDepth(static_cast<int>(items.size()));
+    sortByKey(items, 0, items.size(), depth);
+
+    // из одинаковых ключей оставляем последний (сортировка устойчивая); в multimap остаются все по порядку
+    size_t unique = multimap ? items.size() : 0;
+    for (size_t i = unique; i < items.size(); ++i) {
+        if (unique > 0 && items[unique - 1].first == items[i].first)
+            items[unique - 1] = std::move(items[i]);
+        else if (unique++ != i)
+            items[unique - 1] = std::move(items[i]);
+    }
+    items.erase(items.begin() + unique, items.end());
+
+    destroy(root, forkDepth(size));
+    root = buildBalancedTree(items, 0, static_cast<int>(items.size()) - 1, depth);
+    size = static_cast<int>(items.size());
+    rebuildIndexes();
+    cachedDepth = balancedDepth(size);
+    depthStale = false;
+}
+
+template<typename T, typename Augment>
+template<typename Range>
+void BinaryTree<T, Augment>::bulkLoad(const Range& items) {
+    bulkLoad(std::begin(items), std::end(items));
+}
+
+// items[start..end] превращаются в дерево высоты ровно height (exact) или не больше height.
+// Корень выбирается так, чтобы обе половины помещались в height - 1 уровней,
+// а при exact одна из них могла иметь высоту ровно height - 1
+template<typename T, typename Augment>
+int BinaryTree<T, Augment>::pickShapedRoot(int start, int end, int height, bool exact, TreeShape shape, uint64_t seed,
+                                           bool& leftExact, bool& rightExact) {
+    long long m = end - start + 1;
+    long long capacity = height - 1 >= 62 ? m : (1LL << (height - 1)) - 1; // сколько узлов влезает в height - 1 уровней
+    long long lo = std::max(0LL, m - 1 - capacity), hi = std::min(m - 1, capacity); // допустимый размер левого поддерева
+    long long aLo = lo, aHi = hi; // левое поддерево высокое
+    long long bLo = lo, bHi = hi; // правое поддерево высокое
+    if (exact) {
+        aLo = std::max(lo, static_cast<long long>(height - 1));
+        bHi = std::min(hi, m - height);
+    }
+    if (aLo > aHi) std::swap(aLo, bLo), std::swap(aHi, bHi); // пустой интервал - второй
+    bool twoRanges = bLo <= bHi;
+    if (twoRanges && bLo <= aHi + 1 && aLo <= bHi + 1) { // пересекаются - объединяем
+        aLo = std::min(aLo, bLo);
+        aHi = std::max(aHi, bHi);
+        twoRanges = false;
+    }
+    if (twoRanges && bLo < aLo) std::swap(aLo, bLo), std::swap(aHi, bHi);
+
+    long long left;
+    if (shape == TreeShape::Skewed) {
+        left = aLo;
+    } else if (shape == TreeShape::Random) {
+        uint64_t r = seed ^ (static_cast<uint64_t>(start) * 0x9e3779b97f4a7c15ULL) ^ (static_cast<uint64_t>(end) * 0xc2b2ae3d27d4eb4fULL);
+        r = (r ^ (r >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        r = (r ^ (r >> 27)) * 0x94d049bb133111ebULL;
+        r ^= r >> 31;
+        long long lengthA = aHi - aLo + 1, lengthB = twoRanges ? bHi - bLo + 1 : 0;
+        long long pick = static_cast<long long>(r % static_cast<uint64_t>(lengthA + lengthB));
+        left = pick < lengthA ? aLo + pick : bLo + (pick - lengthA);
+    } else {
+        long long target = (m - 1) / 2;
+        left = std::clamp(target, aLo, aHi);
+        if (twoRanges) {
+            long long other = std::clamp(target, bLo, bHi);
+            if (std::abs(other - target) < std::abs(left - target)) left = other;
+        }
+    }
+
+    long long right = m - 1 - left;
+    leftExact = rightExact = false;
+    if (exact) { // высокой делаем большую из подходящих сторон
+        bool leftCan = left >= height - 1, rightCan = right >= height - 1;
+        leftExact = leftCan && (!rightCan || left >= right);
+        rightExact = !leftExact;
+    }
+
+    return start + static_cast<int>(left);
+}
+
+// верхние depth уровней строятся параллельно рекурсией, ниже - циклом с явным стеком:
+// глубина дерева может доходить до числа узлов, и рекурсия по уровням переполнила бы стек
+template<typename T, typename Augment>
+typename BinaryTree<T, Augment>::Node* BinaryTree<T, Augment>::buildShaped(const std::vector<std::pair<int, T>>& items, int start, int end,
+                                                        int height, bool exact, TreeShape shape, uint64_t seed, int depth) {
+    if (start > end) return nullptr;
+    if (depth > 0) {
+        bool leftExact, rightExact;
+        int mid = pickShapedRoot(start, end, height, exact, shape, seed, leftExact, rightExact);
+        Node* node = new Node(items[mid].first, items[mid].second);
+        ThreadPool::Instance().Invoke(
+            [&] { node->left = buildShaped(items, start, mid - 1, height - 1, leftExact, shape, seed, depth - 1); },
+            [&] { node->right = buildShaped(items, mid + 1, end, height - 1, rightExact, shape, seed, depth - 1); });
+        pull(node);
+        return node;
+    }
+
+    struct Frame {
+        int start, end, height;
+        bool exact;
+        Node** link;
+    };
+    Node* result = nullptr;
+    std::vector<Frame> stack{{start, end, height, exact, &result}};
+    std::vector<Node*> created; // в порядке KLP: обратный порядок - дети раньше родителей, для pull
+    created.reserve(end - start + 1);
+    while (!stack.empty()) {
+        Frame f = stack.back();
+        stack.pop_back();
+        if (f.start > f.end) continue;
+        bool leftExact, rightExact;
+        int mid = pickShapedRoot(f.start, f.end, f.height, f.exact, shape, seed, leftExact, rightExact);
+        Node* node = new Node(items[mid].first, items[mid].second);
+        *f.link = node;
+        created.push_back(node);
+        stack.push_back({mid + 1, f.end, f.height - 1, rightExact, &node->right});
+        stack.push_back({f.start, mid - 1, f.height - 1, leftExact, &node->left});
+    }
+    for (auto it = created.rbegin(); it != created.rend(); ++it) pull(*it);
+    return result;
+}
+
+template<typename T, typename Augment>
+void BinaryTree<T, Augment>::buildWithDepth(const std::vector<std::pair<int, T>>& items, int depth, TreeShape shape, uint64_t seed) {
+    int count = static_cast<int>(items.size());
+    if (depth > kMaxBuildDepth)
+        throw Errors::InvalidArgument("depth must not exceed " + std::to_string(kMaxBuildDepth));
+    if (depth < balancedDepth(count) || depth > count)
+        throw Errors::InvalidArgument("depth for " + std::to_string(count) + " nodes must be in [" +
+                                      std::to_string(balancedDepth(count)) + ", " + std::to_string(count) + "]");
+    for (int i = 1; i < count; ++i)
+        if (items[i - 1].first >= items[i].first)
+            throw Errors::InvalidArgument("keys must be sorted and unique");
+
+    release();
+    root = buildShaped(items, 0, count - 1, depth, true, shape, seed, forkDepth(count));
+    size = count;
+    rebuildIndexes();
+    cachedDepth = depth;
+    depthStale = false;
+}
+
+template<typename T, typename Augment>
+void BinaryTree<T, Augment>::inOrderCollect(Node* node, std::vector<std::pair<int, T>>& out, int depth) const {
     if (!node) return; // если нет нода
+    if (depth > 0) { // правое поддерево собираем в отдельный вектор и дописываем в конец
+        std::vector<std::pair<int, T>> right;
+        ThreadPool::Instance().Invoke(
+            [&] { inOrderCollect(node->left, out, depth - 1); },
+            [&] { inOrderCollect(node->right, right, depth - 1); });
+        out.push_back({node->key, node->value});
+        out.insert(out.end(), std::make_move_iterator(right.begin()), std::make_move_iterator(right.end()));
+        return;
+    }
+    if (threadedScans) { // параллельные ветки обходят непересекающиеся поддеревья - нити не мешают друг другу
+        morris(node, false, [&](Node* n) { out.push_back({n->key, n->value}); });
+        return;
+    }
     inOrderCollect(node->left, out); 
     out.push_back({node->key, node->value}); // закидываем в словарь пару {ключ, значение}
     inOrderCollect(node->right, out);
     //рекурсивно делаем для левой и правой части(ин ордер)
 }
 
-template<typename T>
-void BinaryTree<T>::balance() {
+template<typename T, typename Augment>
+std::vector<std::pair<int, T>> BinaryTree<T, Augment>::toSortedVector() const {
+    std::vector<std::pair<int, T>> items;
+    items.reserve(size);
+    inOrderCollect(root, items, forkDepth(size));
+    return items;
+}
+
+template<typename T, typename Augment>
+void BinaryTree<T, Augment>::balance() {
     std::vector<std::pair<int, T>> nodes; // словарь узлов
-    inOrderCollect(root, nodes); // закидываем все узлы по KLP в словарь
-    destroy(root); // уничтожаем дерево(несбалансированное)
-    root = buildBalancedTree(nodes, 0, nodes.size() - 1); // новый корень для дерева(сбалансированное)
+    int depth = forkDepth(size);
+    inOrderCollect(root, nodes, depth); // закидываем все узлы по KLP в словарь
+    destroy(root, depth); // уничтожаем дерево(несбалансированное)
+    root = buildBalancedTree(nodes, 0, nodes.size() - 1, depth); // новый корень для дерева(сбалансированное)
+    rebuildIndexes();
+    cachedDepth = balancedDepth(size);
+    depthStale = false;
 }
 
-template<typename T>
-int BinaryTree<T>::getDepth(Node* node) const {
+template<typename T, typename Augment>
+int BinaryTree<T, Augment>::getDepth(Node* node, int depth) const {
     if (!node) return 0;
+    if (depth > 0) {
+        int left = 0, right = 0;
+        ThreadPool::Instance().Invoke(
+            [&] { left = getDepth(node->left, depth - 1); },
+            [&] { right = getDepth(node->right, depth - 1); });
+        return 1 + std::max(left, right);
+    }
     return 1 + std::max(getDepth(node->left), getDepth(node->right));
 }
 
-template<typename T>
-int BinaryTree<T>::GetDepth() const {
-    return getDepth(root);
+template<typename T, typename Augment>
+int BinaryTree<T, Augment>::balancedDepth(int nodes) {
+    int depth = 0;
+    while (depth < 31 && (1 << depth) - 1 < nodes) ++depth;
+    return depth;
+}
+
+template<typename T, typename Augment>
+int BinaryTree<T, Augment>::GetDepth() const {
+    if (depthStale) {
+        cachedDepth = getDepth(root, forkDepth(size));
+        depthStale = false;
+    }
+    return cachedDepth;
 }
     
-template<typename T>
-BinaryTree<T>& BinaryTree<T>::operator=(const BinaryTree<T>& other) {
+template<typename T, typename Augment>
+BinaryTree<T, Augment>& BinaryTree<T, Augment>::operator=(const BinaryTree<T, Augment>& other) {
+    if (this != &other) {
+        release();
+        root = copy(other.root, forkDepth(other.size));
+        size = other.size;
+        multimap = other.multimap; // повторы ключей приходят вместе с узлами
+        hashesStale = other.hashesStale; // хеши скопированы как есть
+        rebuildIndexes();
+        cachedDepth = other.cachedDepth;
+        depthStale = other.depthStale;
+        restoreScapegoatBound(); // режим доступа остаётся свой, форма приходит от other
+    }
+    return *this;
+}
+
+template<typename T, typename Augment>
+BinaryTree<T, Augment>& BinaryTree<T, Augment>::operator=(BinaryTree<T, Augment>&& other) noexcept {
     if (this != &other) {
-        destroy(root);
-        root = copy(other.root);
+        release();
+        root = other.root;
         size = other.size;
+        multimap = other.multimap;
+        hashesStale = other.hashesStale;
+        minNode = other.minNode;
+        maxNode = other.maxNode;
+        other.root = nullptr;
+        other.size = 0;
+        other.minNode = other.maxNode = nullptr;
+        bool swapIndex = valueIndex && other.valueIndex, swapFilter = keyFilter && other.keyFilter;
+        if (swapIndex) std::swap(valueIndex, other.valueIndex);
+        if (swapFilter) std::swap(keyFilter, other.keyFilter);
+        if (!swapIndex) rebuildIndexes(); // заодно перестраивает фильтр
+        else if (keyFilter && !swapFilter) rebuildKeyFilter();
+        if (other.valueIndex) other.valueIndex->clear();
+        if (other.keyFilter) other.keyFilter->clear();
+        cachedDepth = other.cachedDepth;
+        depthStale = other.depthStale;
+        maxSize = other.maxSize;
+        other.cachedDepth = 0;
+        other.depthStale = false;
+        other.maxSize = 0;
+        other.touch();
+        restoreScapegoatBound();
     }
     return *this;
 }
 
-template<typename T>
-void BinaryTree<T>::PrintTree() const {
+template<typename T, typename Augment>
+void BinaryTree<T, Augment>::PrintTree() const {
     printNode(root, 0);
 }
 
-template<typename T>
-void BinaryTree<T>::printNode(Node* node, int indent) const {
+template<typename T, typename Augment>
+void BinaryTree<T, Augment>::printNode(Node* node, int indent) const {
     if (node) {
         if (node->right) printNode(node->right, indent + 5);
         
@@ -550,12 +2408,14 @@ void BinaryTree<T>::printNode(Node* node, int indent) const {
 }
 
 
-template<typename T>
-bool BinaryTree<T>::operator==(const BinaryTree<T>& other) const {
-    return equals(this->root, other.root);
+template<typename T, typename Augment>
+bool BinaryTree<T, Augment>::operator==(const BinaryTree<T, Augment>& other) const {
+    bool trustHashes = kHashed && !hashesStale && !other.hashesStale;
+    if (trustHashes && subtreeHash(root) != subtreeHash(other.root)) return false;
+    return equals(this->root, other.root, forkDepth(std::min(size, other.size)));
 }
 
-template<typename T>
-bool BinaryTree<T>::operator!=(const BinaryTree<T>& other) const {
+template<typename T, typename Augment>
+bool BinaryTree<T, Augment>::operator!=(const BinaryTree<T, Augment>& other) const {
     return !(*this == other);
 }
\ No newline at end of file
@@ -0,0 +1,72 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Блочный фильтр Блума для int-ключей: все биты одного ключа лежат в одном 64-байтном блоке,
+// поэтому проверка - одна кеш-линия. Ложных отрицаний нет, ложные срабатывания - около 1-2%
+// при 10 битах на ключ. Удалять ключи нельзя: после удалений фильтр перестраивают заново.
+class BloomFilter {
+public:
+    explicit BloomFilter(size_t expectedKeys = 0, size_t bitsPerKey = 10) {
+        size_t bits = (expectedKeys > 0 ? expectedKeys : 1) * bitsPerKey;
+        blocks.resize((bits + kBlockBits - 1) / kBlockBits);
+        capacity = expectedKeys;
+    }
+
+    void add(int key) {
+        uint64_t h = mix(static_cast<uint64_t>(static_cast<uint32_t>(key)));
+        Block& block = blocks[blockIndex(h)];
+        uint64_t probes = mix(h);
+        for (int i = 0; i < kProbes; ++i, probes >>= 9) {
+            unsigned bit = probes & (kBlockBits - 1);
+            block.words[bit >> 6] |= uint64_t(1) << (bit & 63);
+        }
+        ++count;
+    }
+
+    bool mayContain(int key) const {
+        uint64_t h = mix(static_cast<uint64_t>(static_cast<uint32_t>(key)));
+        const Block& block = blocks[blockIndex(h)];
+        uint64_t probes = mix(h);
+        for (int i = 0; i < kProbes; ++i, probes >>= 9) {
+            unsigned bit = probes & (kBlockBits - 1);
+            if (!((block.words[bit >> 6] >> (bit & 63)) & 1)) return false;
+        }
+        return true;
+    }
+
+    void clear() {
+        for (Block& block : blocks) block = Block{};
+        count = 0;
+    }
+
+    // сколько ключей добавлено и на сколько рассчитан фильтр
+    size_t size() const { return count; }
+    size_t expected() const { return capacity; }
+
+private:
+    static constexpr unsigned kBlockBits = 512;
+    static constexpr int kProbes = 6; // 6 * 9 бит из одного 64-битного хеша
+
+    struct alignas(64) Block {
+        uint64_t words[kBlockBits / 64] = {};
+    };
+
+    std::vector<Block> blocks;
+    size_t count = 0;
+    size_t capacity = 0;
+
+    // splitmix64
+    static uint64_t mix(uint64_t x) {
+        x += 0x9e3779b97f4a7c15ULL;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    // старшие биты хеша -> номер блока без деления
+    size_t blockIndex(uint64_t h) const {
+        return static_cast<size_t>(((h >> 32) * static_cast<uint64_t>(blocks.size())) >> 32);
+    }
+};
@@ -0,0 +1,261 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "Errors.hpp"
+
+// Компактное дерево поиска: все узлы лежат в одном векторе, ссылки - 32-битные номера вместо указателей.
+// Для BinaryTree<int> узел занимает 16 байт вместо 24, дерево целиком переносится и копируется
+// как обычный массив, а для тривиально копируемых T сохраняется на диск и читается обратно как есть.
+// Указатели из search действительны до следующей вставки (пул может переехать).
+template<typename T>
+class CompactBinaryTree {
+private:
+    static constexpr uint32_t kNull = UINT32_MAX;
+
+    struct Node {
+        int key;
+        uint32_t left;
+        uint32_t right;
+        T value;
+    };
+
+    std::vector<Node> nodes;
+    uint32_t root;
+    uint32_t freeHead; // список свободных узлов через left
+    int size;
+
+    uint32_t allocate(int key, const T& value);
+    void release(uint32_t index);
+    uint32_t find(int key) const;
+    uint32_t extreme(bool leftmost) const;
+    void traverse(uint32_t index, const std::function<void(const T&)>& func) const;
+
+public:
+    CompactBinaryTree();
+
+    void insert(int key, const T& value);
+    bool remove(int key);
+    T* search(int key);
+    const T* search(int key) const;
+    T getMin() const;
+    T getMax() const;
+    int getSize() const;
+    void clear();
+    void reserve(size_t count);
+
+    void traverseLKP(std::function<void(const T&)> func) const;
+
+    // сырой образ пула: только для тривиально копируемых T, читать на машине с тем же порядком байт
+    void save(std::ostream& out) const;
+    static CompactBinaryTree<T> load(std::istream& in);
+};
+
+
+template<typename T>
+CompactBinaryTree<T>::CompactBinaryTree() : root(kNull), freeHead(kNull), size(0) {}
+
+template<typename T>
+uint32_t CompactBinaryTree<T>::allocate(int key, const T& value) {
+    ++size;
+    if (freeHead != kNull) {
+        uint32_t index = freeHead;
+        freeHead = nodes[index].left;
+        nodes[index] = Node{key, kNull, kNull, value};
+        return index;
+    }
+    if (nodes.size() >= kNull) throw Errors::IndexOutOfRange();
+    nodes.push_back(Node{key, kNull, kNull, value});
+    return static_cast<uint32_t>(nodes.size() - 1);
+}
+
+template<typename T>
+void CompactBinaryTree<T>::release(uint32_t index) {
+    --size;
+    nodes[index].value = T();
+    nodes[index].left = freeHead;
+    freeHead = index;
+}
+
+template<typename T>
+uint32_t CompactBinaryTree<T>::find(int key) const {
+    uint32_t index = root;
+    while (index != kNull && nodes[index].key != key)
+        index = key < nodes[index].key ? nodes[index].left : nodes[index].right;
+    return index;
+}
+
+// ссылки хранятся как номера, поэтому позиция ссылки - (номер родителя, сторона), а не адрес:
+// allocate может переместить вектор
+template<typename T>
+void CompactBinaryTree<T>::insert(int key, const T& value) {
+    if (root == kNull) {
+        root = allocate(key, value);
+        return;
+    }
+    uint32_t index = root;
+    while (true) {
+        Node& node = nodes[index];
+        if (key == node.key) {
+            node.value = value;
+            return;
+        }
+        uint32_t next = key < node.key ? node.left : node.right;
+        if (next == kNull) break;
+        index = next;
+    }
+    uint32_t created = allocate(key, value);
+    if (key < nodes[index].key) nodes[index].left = created;
+    else nodes[index].right = created;
+}
+
+template<typename T>
+bool CompactBinaryTree<T>::remove(int key) {
+    uint32_t* link = &root;
+    while (*link != kNull && nodes[*link].key != key)
+        link = key < nodes[*link].key ? &nodes[*link].left : &nodes[*link].right;
+    uint32_t index = *link;
+    if (index == kNull) return false;
+
+    Node& node = nodes[index];
+    if (node.left == kNull) {
+        *link = node.right;
+    } else if (node.right == kNull) {
+        *link = node.left;
+    } else { // преемник перецепляется на место узла
+        uint32_t* minLink = &node.right;
+        while (nodes[*minLink].left != kNull) minLink = &nodes[*minLink].left;
+        uint32_t successor = *minLink;
+        *minLink = nodes[successor].right;
+        nodes[successor].left = node.left;
+        nodes[successor].right = node.right;
+        *link = successor;
+    }
+    release(index);
+    return true;
+}
+
+template<typename T>
+T* CompactBinaryTree<T>::search(int key) {
+    uint32_t index = find(key);
+    return index != kNull ? &nodes[index].value : nullptr;
+}
+
+template<typename T>
+const T* CompactBinaryTree<T>::search(int key) const {
+    uint32_t index = find(key);
+    return index != kNull ? &nodes[index].value : nullptr;
+}
+
+template<typename T>
+uint32_t CompactBinaryTree<T>::extreme(bool leftmost) const {
+    if (root == kNull) throw Errors::TreeEmpty();
+    uint32_t index = root;
+    while ((leftmost ? nodes[index].left : nodes[index].right) != kNull)
+        index = leftmost ? nodes[index].left : nodes[index].right;
+    return index;
+}
+
+template<typename T>
+T CompactBinaryTree<T>::getMin() const {
+    return nodes[extreme(true)].value;
+}
+
+template<typename T>
+T CompactBinaryTree<T>::getMax() const {
+    return nodes[extreme(false)].value;
+}
+
+template<typename T>
+int CompactBinaryTree<T>::getSize() const {
+    return size;
+}
+
+template<typename T>
+void CompactBinaryTree<T>::clear() {
+    nodes.clear();
+    root = freeHead = kNull;
+    size = 0;
+}
+
+template<typename T>
+void CompactBinaryTree<T>::reserve(size_t count) {
+    nodes.reserve(count);
+}
+
+template<typename T>
+void CompactBinaryTree<T>::traverse(uint32_t index, const std::function<void(const T&)>& func) const {
+    if (index == kNull) return;
+    traverse(nodes[index].left, func);
+    func(nodes[index].value);
+    traverse(nodes[index].right, func);
+}
+
+template<typename T>
+void CompactBinaryTree<T>::traverseLKP(std::function<void(const T&)> func) const {
+    traverse(root, func);
+}
+
+// формат: число узлов, root, freeHead, size, затем узлы одним блоком
+template<typename T>
+void CompactBinaryTree<T>::save(std::ostream& out) const {
+    static_assert(std::is_trivially_copyable<T>::value, "save/load need a trivially copyable value type");
+    uint64_t count = nodes.size();
+    out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    out.write(reinterpret_cast<const char*>(&root), sizeof(root));
+    out.write(reinterpret_cast<const char*>(&freeHead), sizeof(freeHead));
+    out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    out.write(reinterpret_cast<const char*>(nodes.data()), static_cast<std::streamsize>(count * sizeof(Node)));
+}
+
+template<typename T>
+CompactBinaryTree<T> CompactBinaryTree<T>::load(std::istream& in) {
+    static_assert(std::is_trivially_copyable<T>::value, "save/load need a trivially copyable value type");
+    CompactBinaryTree<T> tree;
+    uint64_t count = 0;
+    in.read(reinterpret_cast<char*>(&count), sizeof(count));
+    in.read(reinterpret_cast<char*>(&tree.root), sizeof(tree.root));
+    in.read(reinterpret_cast<char*>(&tree.freeHead), sizeof(tree.freeHead));
+    in.read(reinterpret_cast<char*>(&tree.size), sizeof(tree.size));
+    if (!in || count >= kNull || tree.size < 0 || static_cast<uint64_t>(tree.size) > count)
+        throw Errors::DeserializeFailed();
+    tree.nodes.resize(count);
+    in.read(reinterpret_cast<char*>(tree.nodes.data()), static_cast<std::streamsize>(count * sizeof(Node)));
+    if (!in) throw Errors::DeserializeFailed();
+
+    // один проход по дереву и списку свободных: каждый номер встречается ровно один раз, иначе
+    // это ссылка за массив, цикл, общий узел или свободный узел, который ещё в дереве.
+    // Заодно ключи проверяются на порядок дерева поиска, а size - на число живых узлов
+    std::vector<bool> seen(count, false);
+    auto claim = [&](uint32_t index) {
+        if (index >= count || seen[index]) throw Errors::DeserializeFailed();
+        seen[index] = true;
+    };
+    struct Pending {
+        uint32_t index;
+        int64_t lo, hi; // допустимые ключи узла
+    };
+    std::vector<Pending> stack;
+    if (tree.root != kNull) stack.push_back({tree.root, std::numeric_limits<int>::min(), std::numeric_limits<int>::max()});
+    uint64_t live = 0;
+    while (!stack.empty()) {
+        Pending pending = stack.back();
+        stack.pop_back();
+        claim(pending.index);
+        ++live;
+        const Node& node = tree.nodes[pending.index];
+        if (node.key < pending.lo || node.key > pending.hi) throw Errors::DeserializeFailed();
+        if (node.left != kNull) stack.push_back({node.left, pending.lo, static_cast<int64_t>(node.key) - 1});
+        if (node.right != kNull) stack.push_back({node.right, static_cast<int64_t>(node.key) + 1, pending.hi});
+    }
+    if (live != static_cast<uint64_t>(tree.size)) throw Errors::DeserializeFailed();
+    for (uint32_t index = tree.freeHead; index != kNull; index = tree.nodes[index].left) claim(index);
+    if (std::find(seen.begin(), seen.end(), false) != seen.end()) throw Errors::DeserializeFailed(); // потерянный узел
+    return tree;
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+// можно ли посчитать std::hash<T> (для std::function, complex и т.п. - нет)
+template<typename T, typename = void>
+struct IsHashable : std::false_type {};
+
+template<typename T>
+struct IsHashable<T, std::void_t<decltype(std::hash<T>{}(std::declval<const T&>()))>> : std::true_type {};
+
+// для нехешируемых типов возвращает 0: равные значения всё равно дают равные хеши
+template<typename T>
+size_t HashValue(const T& value) {
+    if constexpr (IsHashable<T>::value) return std::hash<T>{}(value);
+    else return 0;
+}
+
+// порядок аргументов важен: (a, b) и (b, a) дают разные результаты
+inline size_t HashCombine(size_t seed, size_t value) {
+    return seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+}
@@ -0,0 +1,294 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "Errors.hpp"
+
+// Ассоциативный массив по int-ключу на основе сжатого префиксного дерева (radix trie).
+// 32-битный ключ - это 4 байта, каждый байт выбирает ребёнка на своём уровне (256-арные узлы),
+// поэтому поиск - ровно 4 шага без сравнений ключей, независимо от числа элементов.
+// Занятые ветви узла отмечены битовой маской, а дети хранятся плотно по рангу бита
+// (как в adaptive radix tree) - разреженные ключи не тратят 256 указателей на узел.
+// Порядок ключей сохраняется: обход, минимум/максимум, successor/predecessor.
+template<typename T>
+class IntKeyMap {
+private:
+    static constexpr int kLevels = 4;
+
+    struct Node {
+        uint64_t bits[4] = {0, 0, 0, 0}; // какие байты 0..255 заняты
+        std::vector<std::unique_ptr<Node>> children; // на уровнях 0..2
+        std::vector<T> values;                       // на последнем уровне
+    };
+
+    std::unique_ptr<Node> root;
+    int size;
+
+    // ключи сдвигаются в беззнаковые так, чтобы порядок байтов совпадал с порядком int
+    static uint32_t encode(int key) { return static_cast<uint32_t>(key) ^ 0x80000000u; }
+    static int decode(uint32_t code) { return static_cast<int>(code ^ 0x80000000u); }
+    static int byteAt(uint32_t code, int level) { return (code >> (24 - 8 * level)) & 0xFF; }
+
+    static bool has(const Node* node, int b) { return (node->bits[b >> 6] >> (b & 63)) & 1; }
+    static int rank(const Node* node, int b);
+    static int nextBit(const Node* node, int from); // первый занятый байт >= from или -1
+    static int prevBit(const Node* node, int from); // последний занятый байт <= from или -1
+
+    bool remove(Node* node, uint32_t code, int level);
+    static const Node* extreme(const Node* node, int level, bool leftmost, uint32_t& code);
+    static bool successor(const Node* node, uint32_t code, int level, uint32_t& out);
+    static bool predecessor(const Node* node, uint32_t code, int level, uint32_t& out);
+    static void traverse(const Node* node, int level, uint32_t prefix, const std::function<void(int, const T&)>& func);
+
+public:
+    IntKeyMap();
+    IntKeyMap(const IntKeyMap<T>& other) = delete;
+    IntKeyMap<T>& operator=(const IntKeyMap<T>& other) = delete;
+    IntKeyMap(IntKeyMap<T>&& other) noexcept;
+    IntKeyMap<T>& operator=(IntKeyMap<T>&& other) noexcept;
+
+    void insert(int key, const T& value);
+    bool remove(int key);
+    T* search(int key);
+    const T* search(int key) const;
+    int getSize() const;
+    void clear();
+
+    T getMin() const;
+    T getMax() const;
+    // ближайший ключ строго больше / строго меньше key; false, если такого нет
+    bool successor(int key, int& out) const;
+    bool predecessor(int key, int& out) const;
+
+    // по возрастанию ключей
+    void traverse(std::function<void(int, const T&)> func) const;
+    void traverseLKP(std::function<void(const T&)> func) const;
+};
+
+
+template<typename T>
+IntKeyMap<T>::IntKeyMap() : root(std::make_unique<Node>()), size(0) {}
+
+template<typename T>
+IntKeyMap<T>::IntKeyMap(IntKeyMap<T>&& other) noexcept : root(std::move(other.root)), size(other.size) {
+    other.root = std::make_unique<Node>();
+    other.size = 0;
+}
+
+template<typename T>
+IntKeyMap<T>& IntKeyMap<T>::operator=(IntKeyMap<T>&& other) noexcept {
+    if (this != &other) {
+        root = std::move(other.root);
+        size = other.size;
+        other.root = std::make_unique<Node>();
+        other.size = 0;
+    }
+    return *this;
+}
+
+template<typename T>
+int IntKeyMap<T>::rank(const Node* node, int b) {
+    int word = b >> 6, r = 0;
+    for (int i = 0; i < word; ++i) r += __builtin_popcountll(node->bits[i]);
+    uint64_t mask = (uint64_t(1) << (b & 63)) - 1;
+    return r + __builtin_popcountll(node->bits[word] & mask);
+}
+
+template<typename T>
+int IntKeyMap<T>::nextBit(const Node* node, int from) {
+    if (from > 255) return -1;
+    int word = from >> 6;
+    uint64_t bits = node->bits[word] & (~uint64_t(0) << (from & 63));
+    while (true) {
+        if (bits) return word * 64 + __builtin_ctzll(bits);
+        if (++word == 4) return -1;
+        bits = node->bits[word];
+    }
+}
+
+template<typename T>
+int IntKeyMap<T>::prevBit(const Node* node, int from) {
+    if (from < 0) return -1;
+    int word = from >> 6;
+    int shift = 63 - (from & 63);
+    uint64_t bits = node->bits[word] & (~uint64_t(0) >> shift);
+    while (true) {
+        if (bits) return word * 64 + 63 - __builtin_clzll(bits);
+        if (--word < 0) return -1;
+        bits = node->bits[word];
+    }
+}
+
+template<typename T>
+void IntKeyMap<T>::insert(int key, const T& value) {
+    uint32_t code = encode(key);
+    Node* node = root.get();
+    for (int level = 0; level < kLevels; ++level) {
+        int b = byteAt(code, level);
+        int r = rank(node, b);
+        bool leaf = level == kLevels - 1;
+        if (has(node, b)) {
+            if (leaf) {
+                node->values[r] = value;
+                return;
+            }
+            node = node->children[r].get();
+            continue;
+        }
+        node->bits[b >> 6] |= uint64_t(1) << (b & 63);
+        if (leaf) {
+            node->values.insert(node->values.begin() + r, value);
+            ++size;
+            return;
+        }
+        node = node->children.insert(node->children.begin() + r, std::make_unique<Node>())->get();
+    }
+}
+
+template<typename T>
+T* IntKeyMap<T>::search(int key) {
+    return const_cast<T*>(static_cast<const IntKeyMap<T>&>(*this).search(key));
+}
+
+template<typename T>
+const T* IntKeyMap<T>::search(int key) const {
+    uint32_t code = encode(key);
+    const Node* node = root.get();
+    for (int level = 0; level < kLevels - 1; ++level) {
+        int b = byteAt(code, level);
+        if (!has(node, b)) return nullptr;
+        node = node->children[rank(node, b)].get();
+    }
+    int b = byteAt(code, kLevels - 1);
+    return has(node, b) ? &node->values[rank(node, b)] : nullptr;
+}
+
+// опустевшие узлы освобождаются на обратном пути
+template<typename T>
+bool IntKeyMap<T>::remove(Node* node, uint32_t code, int level) {
+    int b = byteAt(code, level);
+    if (!has(node, b)) return false;
+    int r = rank(node, b);
+    if (level == kLevels - 1) {
+        node->values.erase(node->values.begin() + r);
+    } else {
+        Node* child = node->children[r].get();
+        if (!remove(child, code, level + 1)) return false;
+        if (child->bits[0] | child->bits[1] | child->bits[2] | child->bits[3]) return true; // ребёнок ещё не пуст
+        node->children.erase(node->children.begin() + r);
+    }
+    node->bits[b >> 6] &= ~(uint64_t(1) << (b & 63));
+    return true;
+}
+
+template<typename T>
+bool IntKeyMap<T>::remove(int key) {
+    if (!remove(root.get(), encode(key), 0)) return false;
+    --size;
+    return true;
+}
+
+template<typename T>
+int IntKeyMap<T>::getSize() const {
+    return size;
+}
+
+template<typename T>
+void IntKeyMap<T>::clear() {
+    root = std::make_unique<Node>();
+    size = 0;
+}
+
+template<typename T>
+const typename IntKeyMap<T>::Node* IntKeyMap<T>::extreme(const Node* node, int level, bool leftmost, uint32_t& code) {
+    for (; level < kLevels; ++level) {
+        int b = leftmost ? nextBit(node, 0) : prevBit(node, 255);
+        code = (code & ~(uint32_t(0xFF) << (24 - 8 * level))) | (uint32_t(b) << (24 - 8 * level));
+        if (level < kLevels - 1) node = node->children[rank(node, b)].get();
+    }
+    return node;
+}
+
+template<typename T>
+T IntKeyMap<T>::getMin() const {
+    if (size == 0) throw Errors::TreeEmpty();
+    uint32_t code = 0;
+    const Node* leaf = extreme(root.get(), 0, true, code);
+    return leaf->values.front();
+}
+
+template<typename T>
+T IntKeyMap<T>::getMax() const {
+    if (size == 0) throw Errors::TreeEmpty();
+    uint32_t code = 0;
+    const Node* leaf = extreme(root.get(), 0, false, code);
+    return leaf->values.back();
+}
+
+// сначала ищем внутри ветви того же байта, иначе - минимум следующей занятой ветви
+template<typename T>
+bool IntKeyMap<T>::successor(const Node* node, uint32_t code, int level, uint32_t& out) {
+    int b = byteAt(code, level);
+    int shift = 24 - 8 * level;
+    if (level < kLevels - 1 && has(node, b) &&
+        successor(node->children[rank(node, b)].get(), code, level + 1, out))
+        return true;
+    int next = nextBit(node, b + 1);
+    if (next < 0) return false;
+    out = (code & ~((uint64_t(1) << (shift + 8)) - 1)) | (uint32_t(next) << shift);
+    if (level < kLevels - 1) extreme(node->children[rank(node, next)].get(), level + 1, true, out);
+    return true;
+}
+
+template<typename T>
+bool IntKeyMap<T>::predecessor(const Node* node, uint32_t code, int level, uint32_t& out) {
+    int b = byteAt(code, level);
+    int shift = 24 - 8 * level;
+    if (level < kLevels - 1 && has(node, b) &&
+        predecessor(node->children[rank(node, b)].get(), code, level + 1, out))
+        return true;
+    int prev = prevBit(node, b - 1);
+    if (prev < 0) return false;
+    out = (code & ~((uint64_t(1) << (shift + 8)) - 1)) | (uint32_t(prev) << shift);
+    if (level < kLevels - 1) extreme(node->children[rank(node, prev)].get(), level + 1, false, out);
+    return true;
+}
+
+template<typename T>
+bool IntKeyMap<T>::successor(int key, int& out) const {
+    uint32_t code = 0;
+    if (!successor(root.get(), encode(key), 0, code)) return false;
+    out = decode(code);
+    return true;
+}
+
+template<typename T>
+bool IntKeyMap<T>::predecessor(int key, int& out) const {
+    uint32_t code = 0;
+    if (!predecessor(root.get(), encode(key), 0, code)) return false;
+    out = decode(code);
+    return true;
+}
+
+template<typename T>
+void IntKeyMap<T>::traverse(const Node* node, int level, uint32_t prefix, const std::function<void(int, const T&)>& func) {
+    int shift = 24 - 8 * level;
+    int r = 0;
+    for (int b = nextBit(node, 0); b >= 0; b = nextBit(node, b + 1), ++r) {
+        uint32_t code = prefix | (uint32_t(b) << shift);
+        if (level == kLevels - 1) func(decode(code), node->values[r]);
+        else traverse(node->children[r].get(), level + 1, code, func);
+    }
+}
+
+template<typename T>
+void IntKeyMap<T>::traverse(std::function<void(int, const T&)> func) const {
+    traverse(root.get(), 0, 0, func);
+}
+
+template<typename T>
+void IntKeyMap<T>::traverseLKP(std::function<void(const T&)> func) const {
+    traverse(root.get(), 0, 0, [&](int, const T& value) { func(value); });
+}
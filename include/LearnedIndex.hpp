@@ -0,0 +1,103 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+#include "BinaryTree.hpp"
+#include "Errors.hpp"
+
+// Обученный индекс над неизменяемым отсортированным массивом ключей.
+// Позиция ключа в массиве приближается кусочно-линейной функцией: каждый отрезок гарантирует,
+// что настоящая позиция отличается от предсказанной не больше чем на epsilon. Поиск - выбор
+// отрезка, одно умножение и двоичный поиск в окне 2 * epsilon + 1 вместо всего массива.
+// Отрезки строятся жадно за один проход ("сужающийся конус" допустимых наклонов).
+template<typename T>
+class LearnedIndex {
+public:
+    // items - по возрастанию уникальных ключей
+    explicit LearnedIndex(const std::vector<std::pair<int, T>>& items, int epsilon = 32);
+    static LearnedIndex<T> fromTree(const BinaryTree<T>& tree, int epsilon = 32);
+
+    const T* search(int key) const;
+
+    size_t getSize() const { return keys.size(); }
+    size_t segmentCount() const { return segments.size(); }
+    int getEpsilon() const { return epsilon; }
+
+private:
+    struct Segment {
+        double slope;
+        size_t start; // позиция первого ключа отрезка
+    };
+
+    std::vector<int> keys;
+    std::vector<T> values;
+    std::vector<int> segmentKeys; // первый ключ каждого отрезка, отдельно - для плотного двоичного поиска
+    std::vector<Segment> segments;
+    int epsilon;
+
+    void train();
+};
+
+
+template<typename T>
+LearnedIndex<T>::LearnedIndex(const std::vector<std::pair<int, T>>& items, int epsilon) : epsilon(epsilon) {
+    if (epsilon < 1) throw Errors::InvalidArgument("epsilon must be positive");
+    keys.reserve(items.size());
+    values.reserve(items.size());
+    for (size_t i = 0; i < items.size(); ++i) {
+        if (i > 0 && items[i - 1].first >= items[i].first) throw Errors::InvalidArgument("keys must be sorted and unique");
+        keys.push_back(items[i].first);
+        values.push_back(items[i].second);
+    }
+    train();
+}
+
+template<typename T>
+LearnedIndex<T> LearnedIndex<T>::fromTree(const BinaryTree<T>& tree, int epsilon) {
+    return LearnedIndex<T>(tree.toSortedVector(), epsilon);
+}
+
+// наклон отрезка обязан удерживать каждую следующую точку в пределах epsilon:
+// (dp - eps) / dx <= slope <= (dp + eps) / dx; когда интервал пустеет, начинается новый отрезок
+template<typename T>
+void LearnedIndex<T>::train() {
+    size_t n = keys.size();
+    size_t start = 0;
+    while (start < n) {
+        double lo = 0, hi = INFINITY;
+        size_t end = start + 1;
+        for (; end < n; ++end) {
+            double dx = static_cast<double>(keys[end]) - keys[start];
+            double dp = static_cast<double>(end - start);
+            double newLo = std::max(lo, (dp - epsilon) / dx);
+            double newHi = std::min(hi, (dp + epsilon) / dx);
+            if (newLo > newHi) break;
+            lo = newLo;
+            hi = newHi;
+        }
+        segmentKeys.push_back(keys[start]);
+        segments.push_back({std::isinf(hi) ? 0.0 : (lo + hi) / 2, start});
+        start = end;
+    }
+}
+
+template<typename T>
+const T* LearnedIndex<T>::search(int key) const {
+    auto it = std::upper_bound(segmentKeys.begin(), segmentKeys.end(), key);
+    if (it == segmentKeys.begin()) return nullptr; // меньше всех ключей
+    size_t s = static_cast<size_t>(it - segmentKeys.begin()) - 1;
+    const Segment& segment = segments[s];
+
+    double predicted = segment.start + segment.slope * (static_cast<double>(key) - segmentKeys[s]);
+    // +1 на округление; окно не выходит за соседние отрезки
+    size_t segmentEnd = s + 1 < segments.size() ? segments[s + 1].start : keys.size();
+    double lowPos = std::max<double>(static_cast<double>(segment.start), std::floor(predicted) - epsilon - 1);
+    double highPos = std::min<double>(static_cast<double>(segmentEnd), std::ceil(predicted) + epsilon + 2);
+    if (lowPos >= highPos) return nullptr;
+
+    auto first = keys.begin() + static_cast<size_t>(lowPos), last = keys.begin() + static_cast<size_t>(highPos);
+    auto pos = std::lower_bound(first, last, key);
+    if (pos == last || *pos != key) return nullptr;
+    return &values[pos - keys.begin()];
+}
@@ -0,0 +1,141 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+#include "BinaryTree.hpp"
+#include "Errors.hpp"
+#include "ThreadPool.hpp"
+
+// распределение ключей случайного дерева
+enum class KeyDistribution { Uniform, Zipf, Sequential, Clustered };
+
+// Выборка из распределения Ципфа на [1, n] с показателем s методом rejection-inversion
+// (W. Hörmann, G. Derflinger): O(1) на значение без таблиц, подходит для огромных n.
+class ZipfDistribution {
+public:
+    ZipfDistribution(long long n, double s) : n(n), s(s) {
+        hIntegralX1 = hIntegral(1.5) - 1.0;
+        hIntegralN = hIntegral(n + 0.5);
+        threshold = 2.0 - hIntegralInverse(hIntegral(2.5) - h(2.0));
+    }
+
+    template<typename Rng>
+    long long operator()(Rng& rng) const {
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        while (true) {
+            double u = hIntegralN + uniform(rng) * (hIntegralX1 - hIntegralN);
+            double x = hIntegralInverse(u);
+            long long k = static_cast<long long>(x + 0.5);
+            k = std::clamp(k, 1LL, n);
+            if (k - x <= threshold || u >= hIntegral(k + 0.5) - h(static_cast<double>(k)))
+                return k;
+        }
+    }
+
+private:
+    long long n;
+    double s;
+    double hIntegralX1, hIntegralN, threshold;
+
+    double h(double x) const { return std::exp(-s * std::log(x)); }
+
+    double hIntegral(double x) const {
+        double logX = std::log(x);
+        return helper2((1.0 - s) * logX) * logX;
+    }
+
+    double hIntegralInverse(double x) const {
+        double t = std::max(-1.0, x * (1.0 - s));
+        return std::exp(helper1(t) * x);
+    }
+
+    // log1p(x) / x и expm1(x) / x с разложением около нуля
+    static double helper1(double x) {
+        return std::abs(x) > 1e-8 ? std::log1p(x) / x : 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+    }
+
+    static double helper2(double x) {
+        return std::abs(x) > 1e-8 ? std::expm1(x) / x : 1.0 + x * 0.5 * (1.0 + x * (1.0 / 3.0) * (1.0 + 0.25 * x));
+    }
+};
+
+// Возрастающие уникальные ключи без отбора через множество: ключ = сумма случайных шагов >= 1.
+// Распределение задаёт шаги: Sequential - 1, Uniform - равномерно со средним 4,
+// Zipf - тяжёлый хвост (много соседних ключей и редкие большие дыры), Clustered - плотные кучки.
+// Шаг не больше maxGap, поэтому сумма не переполняет int. Ключи считаются кусками с
+// собственным генератором, поэтому результат при одном seed не зависит от parallel.
+inline std::vector<int> GenerateSortedKeys(int count, KeyDistribution distribution, uint64_t seed, bool parallel) {
+    std::vector<int> keys(count > 0 ? count : 0);
+    if (count <= 0) return keys;
+
+    const int maxGap = std::max(1, (std::numeric_limits<int>::max() - 1) / count);
+    const size_t chunks = std::min<size_t>(64, count);
+    const size_t chunkSize = (count + chunks - 1) / chunks;
+    std::vector<long long> chunkSums(chunks, 0);
+
+    auto forChunks = [&](auto body) {
+        if (parallel) ThreadPool::Instance().ParallelFor(0, chunks, body);
+        else for (size_t c = 0; c < chunks; ++c) body(c);
+    };
+
+    // шаги
+    forChunks([&](size_t c) {
+        size_t begin = c * chunkSize, end = std::min<size_t>(count, begin + chunkSize);
+        std::seed_seq seq{static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32), static_cast<uint32_t>(c)};
+        std::mt19937 rng(seq);
+        std::uniform_int_distribution<int> uniformGap(1, std::min(maxGap, 7));
+        std::uniform_int_distribution<int> jump(1, maxGap);
+        std::bernoulli_distribution clusterEnd(1.0 / 32);
+        ZipfDistribution zipf(maxGap, 1.2);
+        long long sum = 0;
+        for (size_t i = begin; i < end; ++i) {
+            int gap = 1;
+            switch (distribution) {
+                case KeyDistribution::Sequential: gap = 1; break;
+                case KeyDistribution::Uniform: gap = uniformGap(rng); break;
+                case KeyDistribution::Zipf: gap = static_cast<int>(zipf(rng)); break;
+                case KeyDistribution::Clustered: gap = clusterEnd(rng) ? jump(rng) : 1; break;
+            }
+            keys[i] = gap;
+            sum += gap;
+        }
+        chunkSums[c] = sum;
+    });
+
+    // префиксные суммы: сначала по кускам, потом внутри каждого куска
+    std::vector<long long> offsets(chunks, 0);
+    for (size_t c = 1; c < chunks; ++c) offsets[c] = offsets[c - 1] + chunkSums[c - 1];
+    forChunks([&](size_t c) {
+        size_t begin = c * chunkSize, end = std::min<size_t>(count, begin + chunkSize);
+        long long key = offsets[c] - 1; // первый ключ начинается с 0
+        for (size_t i = begin; i < end; ++i) {
+            key += keys[i];
+            keys[i] = static_cast<int>(key);
+        }
+    });
+    return keys;
+}
+
+// Случайное дерево из nodes узлов ровно глубины depth (ключ = значение), depth <= BinaryTree<int>::kMaxBuildDepth.
+// Строится сразу из отсортированных ключей, без вставок и перебалансировок.
+inline BinaryTree<int> RandomTree(int nodes, int depth,
+                                  KeyDistribution distribution = KeyDistribution::Uniform,
+                                  TreeShape shape = TreeShape::Random,
+                                  bool parallel = false,
+                                  uint64_t seed = std::random_device{}()) {
+    if (nodes <= 0 || depth <= 0) throw Errors::InvalidArgument("Nodes and depth must be positive.");
+
+    std::vector<std::pair<int, int>> items;
+    {
+        std::vector<int> keys = GenerateSortedKeys(nodes, distribution, seed, parallel);
+        items.resize(keys.size());
+        for (size_t i = 0; i < keys.size(); ++i) items[i] = {keys[i], keys[i]};
+    }
+
+    BinaryTree<int> tree;
+    tree.buildWithDepth(items, depth, shape, seed);
+    return tree;
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Фоновый поток для отложенного освобождения памяти: владелец отдаёт ему
+// отцепленную структуру и сразу продолжает работу, а удаление идёт в фоне.
+class Reclaimer {
+public:
+    static Reclaimer& Instance() {
+        static Reclaimer reclaimer;
+        return reclaimer;
+    }
+
+    Reclaimer(const Reclaimer&) = delete;
+    Reclaimer& operator=(const Reclaimer&) = delete;
+
+    // после разрушения синглтона (выход из программы) задачи выполняются сразу
+    static void Defer(std::function<void()> job) {
+        if (!alive.load(std::memory_order_acquire)) {
+            job();
+            return;
+        }
+        Instance().Push(std::move(job));
+    }
+
+    // ждёт, пока всё отложенное будет освобождено
+    void Wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        idleCv.wait(lock, [this] { return jobs.empty() && !busy; });
+    }
+
+private:
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::condition_variable idleCv;
+    bool busy = false;
+    bool stopping = false;
+    std::thread worker;
+
+    static inline std::atomic<bool> alive{true};
+
+    Reclaimer() : worker([this] { Loop(); }) {}
+
+    ~Reclaimer() {
+        alive.store(false, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        cv.notify_one();
+        worker.join(); // дочищает очередь перед выходом
+    }
+
+    void Push(std::function<void()> job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(std::move(job));
+        }
+        cv.notify_one();
+    }
+
+    void Loop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            cv.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (jobs.empty()) return;
+            std::function<void()> job = std::move(jobs.front());
+            jobs.pop_front();
+            busy = true;
+            lock.unlock();
+            job();
+            lock.lock();
+            busy = false;
+            if (jobs.empty()) idleCv.notify_all();
+        }
+    }
+};
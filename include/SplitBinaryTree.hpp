@@ -0,0 +1,241 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+#include "Errors.hpp"
+
+// Дерево поиска с раздельным хранением: в узлах только ключ, номер ячейки и ссылки (24 байта),
+// значения лежат отдельно в пуле values. Спуск по дереву читает только узлы, поэтому
+// для тяжёлых T (Student, Teacher) в кеш не тянутся строки на каждом шаге поиска.
+// Указатели из search действительны до следующей вставки (пул может переехать).
+template<typename T>
+class SplitBinaryTree {
+private:
+    struct Node {
+        int key;
+        uint32_t slot; // номер значения в values
+        Node* left;
+        Node* right;
+
+        Node(int k, uint32_t s) : key(k), slot(s), left(nullptr), right(nullptr) {}
+    };
+
+    Node* root;
+    int size;
+    std::vector<T> values;
+    std::vector<uint32_t> freeSlots; // ячейки удалённых значений, занимаются повторно
+
+    static void destroy(Node* node);
+    static Node* copy(Node* node);
+    uint32_t store(const T& value);
+    void release(uint32_t slot);
+    Node* find(int key) const;
+    const Node* extreme(bool leftmost) const;
+    void traverse(Node* node, const std::function<void(const T&)>& func) const;
+
+public:
+    SplitBinaryTree();
+    SplitBinaryTree(const SplitBinaryTree<T>& other);
+    SplitBinaryTree(SplitBinaryTree<T>&& other) noexcept;
+    ~SplitBinaryTree();
+
+    SplitBinaryTree<T>& operator=(const SplitBinaryTree<T>& other);
+    SplitBinaryTree<T>& operator=(SplitBinaryTree<T>&& other) noexcept;
+
+    void insert(int key, const T& value);
+    bool remove(int key);
+    T* search(int key);
+    const T* search(int key) const;
+    T getMin() const;
+    T getMax() const;
+    int getSize() const;
+    void clear();
+
+    void traverseLKP(std::function<void(const T&)> func) const;
+};
+
+
+template<typename T>
+SplitBinaryTree<T>::SplitBinaryTree() : root(nullptr), size(0) {}
+
+template<typename T>
+SplitBinaryTree<T>::SplitBinaryTree(const SplitBinaryTree<T>& other)
+    : root(copy(other.root)), size(other.size), values(other.values), freeSlots(other.freeSlots) {}
+
+template<typename T>
+SplitBinaryTree<T>::SplitBinaryTree(SplitBinaryTree<T>&& other) noexcept
+    : root(other.root), size(other.size), values(std::move(other.values)), freeSlots(std::move(other.freeSlots)) {
+    other.root = nullptr;
+    other.size = 0;
+}
+
+template<typename T>
+SplitBinaryTree<T>::~SplitBinaryTree() {
+    destroy(root);
+}
+
+template<typename T>
+SplitBinaryTree<T>& SplitBinaryTree<T>::operator=(const SplitBinaryTree<T>& other) {
+    if (this != &other) {
+        SplitBinaryTree<T> temp(other);
+        *this = std::move(temp);
+    }
+    return *this;
+}
+
+template<typename T>
+SplitBinaryTree<T>& SplitBinaryTree<T>::operator=(SplitBinaryTree<T>&& other) noexcept {
+    if (this != &other) {
+        destroy(root);
+        root = other.root;
+        size = other.size;
+        values = std::move(other.values);
+        freeSlots = std::move(other.freeSlots);
+        other.root = nullptr;
+        other.size = 0;
+    }
+    return *this;
+}
+
+template<typename T>
+void SplitBinaryTree<T>::destroy(Node* node) {
+    if (!node) return;
+    destroy(node->left);
+    destroy(node->right);
+    delete node;
+}
+
+// номера ячеек сохраняются, поэтому пул копируется как есть
+template<typename T>
+typename SplitBinaryTree<T>::Node* SplitBinaryTree<T>::copy(Node* node) {
+    if (!node) return nullptr;
+    Node* newNode = new Node(node->key, node->slot);
+    newNode->left = copy(node->left);
+    newNode->right = copy(node->right);
+    return newNode;
+}
+
+template<typename T>
+uint32_t SplitBinaryTree<T>::store(const T& value) {
+    if (!freeSlots.empty()) {
+        uint32_t slot = freeSlots.back();
+        freeSlots.pop_back();
+        values[slot] = value;
+        return slot;
+    }
+    values.push_back(value);
+    return static_cast<uint32_t>(values.size() - 1);
+}
+
+template<typename T>
+void SplitBinaryTree<T>::release(uint32_t slot) {
+    values[slot] = T(); // строки и прочие ресурсы освобождаются сразу
+    freeSlots.push_back(slot);
+}
+
+// спуск идёт только по узлам, values не трогается
+template<typename T>
+typename SplitBinaryTree<T>::Node* SplitBinaryTree<T>::find(int key) const {
+    Node* node = root;
+    while (node && node->key != key) node = key < node->key ? node->left : node->right;
+    return node;
+}
+
+template<typename T>
+void SplitBinaryTree<T>::insert(int key, const T& value) {
+    Node** link = &root;
+    while (*link) {
+        if (key == (*link)->key) {
+            values[(*link)->slot] = value;
+            return;
+        }
+        link = key < (*link)->key ? &(*link)->left : &(*link)->right;
+    }
+    *link = new Node(key, store(value));
+    ++size;
+}
+
+// узел с двумя детьми заменяется наименьшим узлом правого поддерева (перецеплением)
+template<typename T>
+bool SplitBinaryTree<T>::remove(int key) {
+    Node** link = &root;
+    while (*link && (*link)->key != key) link = key < (*link)->key ? &(*link)->left : &(*link)->right;
+    Node* node = *link;
+    if (!node) return false;
+
+    if (!node->left) {
+        *link = node->right;
+    } else if (!node->right) {
+        *link = node->left;
+    } else {
+        Node** minLink = &node->right;
+        while ((*minLink)->left) minLink = &(*minLink)->left;
+        Node* successor = *minLink;
+        *minLink = successor->right;
+        successor->left = node->left;
+        successor->right = node->right;
+        *link = successor;
+    }
+    release(node->slot);
+    delete node;
+    --size;
+    return true;
+}
+
+template<typename T>
+T* SplitBinaryTree<T>::search(int key) {
+    Node* node = find(key);
+    return node ? &values[node->slot] : nullptr;
+}
+
+template<typename T>
+const T* SplitBinaryTree<T>::search(int key) const {
+    Node* node = find(key);
+    return node ? &values[node->slot] : nullptr;
+}
+
+template<typename T>
+const typename SplitBinaryTree<T>::Node* SplitBinaryTree<T>::extreme(bool leftmost) const {
+    if (!root) throw Errors::TreeEmpty();
+    const Node* node = root;
+    while (leftmost ? node->left : node->right) node = leftmost ? node->left : node->right;
+    return node;
+}
+
+template<typename T>
+T SplitBinaryTree<T>::getMin() const {
+    return values[extreme(true)->slot];
+}
+
+template<typename T>
+T SplitBinaryTree<T>::getMax() const {
+    return values[extreme(false)->slot];
+}
+
+template<typename T>
+int SplitBinaryTree<T>::getSize() const {
+    return size;
+}
+
+template<typename T>
+void SplitBinaryTree<T>::clear() {
+    destroy(root);
+    root = nullptr;
+    size = 0;
+    values.clear();
+    freeSlots.clear();
+}
+
+template<typename T>
+void SplitBinaryTree<T>::traverse(Node* node, const std::function<void(const T&)>& func) const {
+    if (!node) return;
+    traverse(node->left, func);
+    func(values[node->slot]);
+    traverse(node->right, func);
+}
+
+template<typename T>
+void SplitBinaryTree<T>::traverseLKP(std::function<void(const T&)> func) const {
+    traverse(root, func);
+}
@@ -0,0 +1,231 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Планировщик задач с кражей работы для параллельной обработки поддеревьев (fork/join).
+// У каждого рабочего потока своя очередь: свои задачи он берёт с конца (LIFO - горячие
+// в кеше), а свободные потоки крадут с начала чужих очередей (там самые крупные поддеревья).
+// Поток, ожидающий завершения своей задачи, не спит, а выполняет чужие,
+// поэтому вложенные Invoke не приводят к дедлоку.
+class ThreadPool {
+public:
+    static ThreadPool& Instance() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    explicit ThreadPool(unsigned threads = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // сколько потоков участвует в работе (рабочие + вызывающий)
+    unsigned Size() const { return static_cast<unsigned>(workers.size()) + 1; }
+
+    // пересоздаёт рабочие потоки; вызывать, когда пул простаивает
+    void SetThreadCount(unsigned threads);
+
+    // выполняет a и b параллельно и возвращается, когда обе закончены
+    template<typename A, typename B>
+    void Invoke(A&& a, B&& b);
+
+    // body(i) для каждого i из [begin, end); диапазон делится пополам между потоками
+    template<typename F>
+    void ParallelFor(size_t begin, size_t end, const F& body);
+
+private:
+    struct Task {
+        std::function<void()> fn;
+        std::atomic<bool> done{false};
+        std::exception_ptr error;
+    };
+
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<Task*> tasks;
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<WorkQueue>> queues; // по одной на рабочий поток + последняя общая для внешних потоков
+    std::atomic<int> pending{0};
+    std::mutex sleepMutex;
+    std::condition_variable sleepCv;
+    bool stopping = false;
+
+    // очередь текущего потока в этом пуле
+    static thread_local ThreadPool* currentPool;
+    static thread_local size_t currentQueue;
+
+    void Start(unsigned threads);
+    void Stop();
+    void WorkerLoop(size_t index);
+    WorkQueue& OwnQueue();
+    void Push(Task* task);
+    bool TakeBack(Task* task);
+    bool RunOne(size_t start);
+    static void Execute(Task* task);
+};
+
+inline thread_local ThreadPool* ThreadPool::currentPool = nullptr;
+inline thread_local size_t ThreadPool::currentQueue = 0;
+
+
+inline ThreadPool::ThreadPool(unsigned threads) {
+    Start(threads);
+}
+
+inline ThreadPool::~ThreadPool() {
+    Stop();
+}
+
+inline void ThreadPool::SetThreadCount(unsigned threads) {
+    Stop();
+    Start(threads);
+}
+
+inline void ThreadPool::Start(unsigned threads) {
+    if (threads == 0) threads = 1;
+    stopping = false;
+    for (unsigned i = 0; i < threads; ++i) // threads - 1 рабочих очередей + общая
+        queues.push_back(std::make_unique<WorkQueue>());
+    for (unsigned i = 0; i + 1 < threads; ++i)
+        workers.emplace_back([this, i] { WorkerLoop(i); });
+}
+
+inline void ThreadPool::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    sleepCv.notify_all();
+    for (auto& w : workers) w.join();
+    workers.clear();
+    queues.clear();
+}
+
+inline void ThreadPool::Execute(Task* task) {
+    try {
+        task->fn();
+    } catch (...) {
+        task->error = std::current_exception();
+    }
+    task->done.store(true, std::memory_order_release);
+}
+
+inline ThreadPool::WorkQueue& ThreadPool::OwnQueue() {
+    if (currentPool == this) return *queues[currentQueue];
+    return *queues.back();
+}
+
+inline void ThreadPool::Push(Task* task) {
+    WorkQueue& queue = OwnQueue();
+    pending.fetch_add(1, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(task);
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex); // не даём спящему потоку пропустить сигнал
+    }
+    sleepCv.notify_one();
+}
+
+// забирает задачу обратно, если её ещё никто не украл
+inline bool ThreadPool::TakeBack(Task* task) {
+    WorkQueue& queue = OwnQueue();
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    for (auto it = queue.tasks.rbegin(); it != queue.tasks.rend(); ++it) {
+        if (*it == task) {
+            queue.tasks.erase(std::next(it).base());
+            pending.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+// своя очередь - с конца, чужие - с начала
+inline bool ThreadPool::RunOne(size_t start) {
+    for (size_t i = 0; i < queues.size(); ++i) {
+        size_t index = (start + i) % queues.size();
+        WorkQueue& queue = *queues[index];
+        Task* task = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.tasks.empty()) continue;
+            if (i == 0 && currentPool == this) {
+                task = queue.tasks.back();
+                queue.tasks.pop_back();
+            } else {
+                task = queue.tasks.front();
+                queue.tasks.pop_front();
+            }
+        }
+        pending.fetch_sub(1, std::memory_order_relaxed);
+        Execute(task);
+        return true;
+    }
+    return false;
+}
+
+inline void ThreadPool::WorkerLoop(size_t index) {
+    currentPool = this;
+    currentQueue = index;
+    while (true) {
+        if (RunOne(index)) continue;
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepCv.wait(lock, [this] { return stopping || pending.load(std::memory_order_acquire) > 0; });
+        if (stopping) return;
+    }
+}
+
+template<typename A, typename B>
+void ThreadPool::Invoke(A&& a, B&& b) {
+    if (workers.empty()) {
+        a();
+        b();
+        return;
+    }
+
+    Task task;
+    task.fn = std::forward<B>(b);
+    Push(&task);
+
+    std::exception_ptr error;
+    try {
+        a();
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    // если задачу никто не украл - выполняем её сами
+    if (TakeBack(&task)) Execute(&task);
+
+    size_t start = currentPool == this ? currentQueue : queues.size() - 1;
+    while (!task.done.load(std::memory_order_acquire)) {
+        if (!RunOne(start)) std::this_thread::yield();
+    }
+
+    if (error) std::rethrow_exception(error);
+    if (task.error) std::rethrow_exception(task.error);
+}
+
+template<typename F>
+void ThreadPool::ParallelFor(size_t begin, size_t end, const F& body) {
+    if (begin >= end) return;
+    if (workers.empty() || end - begin == 1) {
+        for (size_t i = begin; i < end; ++i) body(i);
+        return;
+    }
+    size_t mid = begin + (end - begin) / 2;
+    Invoke([&] { ParallelFor(begin, mid, body); },
+           [&] { ParallelFor(mid, end, body); });
+}
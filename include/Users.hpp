@@ -1,6 +1,7 @@
 #pragma once
 #include <iostream>
 #include <string>
+#include "Hashing.hpp"
 
 // Базовая структура User
 struct User {
@@ -132,3 +133,32 @@ struct Teacher : public User {
     }
 };
 
+// хеши нужны для структурного сравнения деревьев
+namespace std {
+    template<>
+    struct hash<User> {
+        size_t operator()(const User& user) const {
+            size_t h = hash<string>{}(user.name);
+            h = HashCombine(h, hash<int>{}(user.age));
+            return HashCombine(h, hash<int>{}(user.id));
+        }
+    };
+
+    template<>
+    struct hash<Student> {
+        size_t operator()(const Student& student) const {
+            size_t h = hash<User>{}(student);
+            h = HashCombine(h, hash<string>{}(student.group));
+            return HashCombine(h, hash<double>{}(student.gpa));
+        }
+    };
+
+    template<>
+    struct hash<Teacher> {
+        size_t operator()(const Teacher& teacher) const {
+            size_t h = hash<User>{}(teacher);
+            h = HashCombine(h, hash<string>{}(teacher.subject));
+            return HashCombine(h, hash<int>{}(teacher.experience));
+        }
+    };
+}
@@ -1,14 +1,22 @@
 #define CATCH_CONFIG_MAIN
 #include "catch.hpp"
 #include "BinaryTree.hpp"
+#include "RandomTree.hpp"
+#include "SplitBinaryTree.hpp"
+#include "CompactBinaryTree.hpp"
+#include "IntKeyMap.hpp"
+#include "LearnedIndex.hpp"
 #include "Users.hpp"
 #include "Errors.hpp"
 #include <complex>
 #include <fstream>
+#include <sstream>
 #include <chrono>
 #include <cmath>
 #include <random>
 #include <numeric>
+#include <limits>
+#include <map>
 
 
 
@@ -241,6 +249,38 @@ TEST_CASE("BinaryTree: Balance reduces tree depth") {
 }
 
 
+TEST_CASE("BinaryTree: map keeps keys and shape") {
+    BinaryTree<Student> tree;
+    tree.insert(20, Student("Ann", 19, 20, "B1", 4.0));
+    tree.insert(10, Student("Bob", 20, 10, "B1", 3.0));
+    tree.insert(30, Student("Eve", 21, 30, "B2", 3.5));
+
+    BinaryTree<Student> mapped = tree.map([](const Student& s) {
+        Student r = s;
+        r.gpa += 0.5;
+        return r;
+    });
+
+    REQUIRE(mapped.search(10)->gpa == Approx(3.5));
+    REQUIRE(mapped.search(20)->gpa == Approx(4.5));
+    REQUIRE(mapped.search(30)->name == "Eve");
+    REQUIRE(mapped.GetDepth() == tree.GetDepth());
+    REQUIRE(tree.search(10)->gpa == Approx(3.0)); // исходное дерево не меняется
+}
+
+TEST_CASE("BinaryTree: where keeps keys") {
+    BinaryTree<int> tree;
+    for (int i = 1; i <= 100; ++i) tree.insert(i, i * 10);
+
+    BinaryTree<int> even = tree.where([](const int& v) { return v % 20 == 0; });
+    for (int i = 1; i <= 100; ++i) {
+        if (i % 2 == 0) REQUIRE(*even.search(i) == i * 10);
+        else REQUIRE(even.search(i) == nullptr);
+    }
+    REQUIRE(even.GetDepth() <= 6); // результат строится сбалансированным
+}
+
+
 
 void benchmark_binary_tree(const std::string& filename) {
     std::ofstream file(filename);
@@ -283,6 +323,1759 @@ TEST_CASE("Benchmark: BinaryTree performance", "[Benchmark]") {
     REQUIRE(true);
 }
 
+TEST_CASE("BinaryTree: bulkLoad from unsorted input") {
+    std::vector<std::pair<int, int>> items;
+    for (int i = 0; i < 1000; ++i) items.push_back({(i * 7919) % 1000, i});
+    items.push_back({5, -1}); // повтор ключа: побеждает последняя пара
+
+    BinaryTree<int> tree;
+    tree.insert(2000, 1);
+    tree.insert(5, 42);
+    tree.bulkLoad(items);
+
+    REQUIRE(*tree.search(5) == -1);
+    REQUIRE(*tree.search(2000) == 1);
+    REQUIRE(*tree.search((7 * 7919) % 1000) == 7);
+    REQUIRE(tree.GetDepth() == 10); // 1001 узел, идеально сбалансировано
+
+    int count = 0;
+    tree.traverseLKP([&](const int&) { ++count; });
+    REQUIRE(count == 1001);
+
+    BinaryTree<int> fromIterators;
+    fromIterators.bulkLoad(items.begin(), items.begin() + 3);
+    REQUIRE(*fromIterators.search(0) == 0);
+    REQUIRE(fromIterators.search(999) == nullptr);
+}
+
+TEST_CASE("BinaryTree: parallel operations on a work-stealing pool") {
+    ThreadPool::Instance().SetThreadCount(4);
+
+    const int N = 50000; // больше порога распараллеливания
+    std::vector<int> keys(N);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::shuffle(keys.begin(), keys.end(), std::mt19937{42});
+
+    BinaryTree<int> tree;
+    for (int key : keys) tree.insert(key, key);
+
+    BinaryTree<int> copied(tree);
+    REQUIRE(copied == tree);
+    REQUIRE(copied.GetDepth() == tree.GetDepth());
+
+    copied.insert(N, N);
+    REQUIRE(copied != tree);
+
+    long long sum = tree.transformReduce(0LL,
+        [](long long a, long long b) { return a + b; },
+        [](const int& v) { return static_cast<long long>(v); });
+    REQUIRE(sum == static_cast<long long>(N) * (N - 1) / 2);
+
+    BinaryTree<int> doubled = tree.map([](const int& v) { return v * 2; });
+    BinaryTree<int> odd = tree.where([](const int& v) { return v % 2 == 1; });
+    for (int i = 0; i < N; i += 997) {
+        REQUIRE(*doubled.search(i) == i * 2);
+        REQUIRE((odd.search(i) != nullptr) == (i % 2 == 1));
+    }
+
+    tree.balance();
+    REQUIRE(tree.GetDepth() == 16);
+    copied = tree;
+    REQUIRE(copied == tree);
+
+    REQUIRE_THROWS_AS(ThreadPool::Instance().Invoke([] {}, [] { throw std::runtime_error("task"); }), std::runtime_error);
+
+    ThreadPool::Instance().SetThreadCount(std::thread::hardware_concurrency());
+}
+
+TEST_CASE("BinaryTree: move and deferred destruction") {
+    const int N = 20000;
+    BinaryTree<std::string> tree;
+    tree.setDeferredDestroy(true);
+    for (int i = 0; i < N; ++i) tree.insert((i * 7919) % N, std::to_string(i));
+
+    BinaryTree<std::string> moved(std::move(tree));
+    REQUIRE(tree.search(0) == nullptr);
+    REQUIRE(*moved.search(7919 % N) == "1");
+
+    BinaryTree<std::string> other;
+    other.insert(1, "one");
+    other = std::move(moved); // старое маленькое дерево удаляется сразу, большое переезжает
+    REQUIRE(*other.search(7919 % N) == "1");
+
+    {
+        BinaryTree<std::string> dropped(other);
+        REQUIRE(dropped == other);
+    } // копия ушла в фоновый поток
+
+    other = BinaryTree<std::string>();
+    REQUIRE(other.search(7919 % N) == nullptr);
+    Reclaimer::Instance().Wait();
+}
+
+TEST_CASE("BinaryTree: subtree hashes for equality and containsSubtree") {
+    using Hashed = BinaryTree<int, StructuralHash>; // хеши только по выбору типа дерева
+    Hashed a, b;
+    for (int key : {50, 30, 70, 20, 40, 60, 80}) {
+        a.insert(key, key);
+        b.insert(key, key);
+    }
+    REQUIRE(a == b);
+
+    b.insert(10, 10);
+    REQUIRE(a != b);
+    REQUIRE(b.remove(10));
+    REQUIRE(a == b); // хеши пересчитываются и при удалении
+
+    Hashed sub;
+    for (int key : {70, 60, 80}) sub.insert(key, key);
+    REQUIRE(a.containsSubtree(sub));
+    sub.insert(90, 90);
+    REQUIRE_FALSE(a.containsSubtree(sub));
+
+    // те же значения, но другая форма
+    Hashed chain;
+    for (int key : {20, 30, 40, 50, 60, 70, 80}) chain.insert(key, key);
+    REQUIRE(chain != a);
+    Hashed leftChild, rightChild; // одинаковый порядок LKP (1, 2), ребёнок с разных сторон
+    leftChild.insert(2, 2);
+    leftChild.insert(1, 1);
+    rightChild.insert(1, 1);
+    rightChild.insert(2, 2);
+    REQUIRE(leftChild != rightChild);
+
+    // хеш уживается с другими сводками в AugmentPair
+    BinaryTree<int, AugmentPair<CountAugment, StructuralHash>> counted, same;
+    for (int key : {50, 30, 70, 20}) {
+        counted.insert(key, key);
+        same.insert(key, key);
+    }
+    REQUIRE(counted == same);
+    REQUIRE(counted.aggregate(25, 70)->first == 3);
+    same.insert(10, 10);
+    REQUIRE(counted != same);
+    BinaryTree<int> plain; // без хешей operator== сравнивает узлы
+    plain.insert(1, 1);
+    REQUIRE(plain == BinaryTree<int>::fromString(plain.toString()));
+
+    // чтение через константное дерево отдаёт const T* и хешам не мешает;
+    // изменяемый указатель из неконстантного search помечает их устаревшими до rehash
+    static_assert(std::is_same_v<decltype(std::as_const(a).search(50)), const int*>);
+    static_assert(std::is_same_v<decltype(std::as_const(a).findByPath("")), const int*>);
+    Hashed edited = a;
+    *edited.search(60) = 61;
+    REQUIRE(edited != a);
+    *edited.search(60) = 60;
+    REQUIRE(edited == a);
+    edited.rehash();
+    REQUIRE(edited == a);
+
+    // порядок вставки с двумя детьми и удаление корня
+    Hashed c = a;
+    REQUIRE(c.remove(50));
+    REQUIRE(c != a);
+    c.insert(50, 50);
+    REQUIRE(c.containsNode(50));
+}
+
+TEST_CASE("BinaryTree: value index for containsNode and findByRelativePath") {
+    BinaryTree<std::string> tree;
+    tree.enableValueIndex();
+    tree.insert(50, "root");
+    tree.insert(30, "left");
+    tree.insert(70, "right");
+    tree.insert(60, "right-left");
+
+    REQUIRE(tree.containsNode("left"));
+    REQUIRE_FALSE(tree.containsNode("missing"));
+    REQUIRE(*tree.findByRelativePath("L", "right") == "right-left");
+
+    tree.insert(30, "left-2"); // перезапись значения обновляет индекс
+    REQUIRE_FALSE(tree.containsNode("left"));
+    REQUIRE(tree.containsNode("left-2"));
+
+    *tree.search(30) = "left-3"; // правка в обход индекса
+    REQUIRE(tree.containsNode("left-3"));
+    REQUIRE_FALSE(tree.containsNode("left-2"));
+    *tree.search(30) = "left-2";
+
+    tree.insert(90, "edited-before-remove");
+    *tree.search(90) = "edited";
+    REQUIRE(tree.remove(90)); // из индекса уходит запись под исходным хешем
+    REQUIRE_FALSE(tree.containsNode("edited-before-remove"));
+    REQUIRE_FALSE(tree.containsNode("edited"));
+
+    REQUIRE(tree.remove(50)); // два ребёнка: узел преемника встаёт на место удалённого, записи индекса не меняются
+    REQUIRE_FALSE(tree.containsNode("root"));
+    REQUIRE(*tree.findByRelativePath("", "right-left") == "right-left");
+    REQUIRE(*tree.findByRelativePath("P", "right-left") == "right");
+
+    tree.balance(); // узлы пересоздаются - индекс тоже
+    REQUIRE(tree.containsNode("right"));
+    REQUIRE(tree.findByRelativePath("PP", "right") == nullptr);
+
+    BinaryTree<std::string> copied(tree);
+    REQUIRE(copied.containsNode("left-2"));
+    copied = BinaryTree<std::string>();
+    REQUIRE_FALSE(copied.containsNode("left-2"));
+
+    BinaryTree<Student> students;
+    students.enableValueIndex();
+    Student ann("Ann", 19, 1, "B1", 4.0);
+    students.insert(1, ann);
+    students.insert(2, Student("Bob", 20, 2, "B1", 3.0));
+    REQUIRE(students.containsNode(ann));
+    REQUIRE(students.findByRelativePath("P", ann)->name == "Bob");
+}
+
+TEST_CASE("BinaryTree: cached min/max and priority queue usage") {
+    BinaryTree<std::string> tree;
+    REQUIRE_THROWS_AS(tree.minRef(), std::runtime_error);
+    REQUIRE_THROWS_AS(tree.popMax(), std::runtime_error);
+
+    for (int key : {50, 30, 70, 20, 40, 60, 80, 35})
+        tree.insert(key, std::to_string(key));
+    REQUIRE(tree.minRef() == "20");
+    REQUIRE(tree.maxRef() == "80");
+
+    REQUIRE(tree.remove(20));
+    REQUIRE(tree.getMin() == "30");
+    REQUIRE(tree.remove(50)); // преемник 60 переезжает в корень
+    REQUIRE(tree.getMax() == "80");
+
+    std::vector<std::string> ascending;
+    while (true) {
+        try {
+            ascending.push_back(tree.popMin());
+        } catch (const std::runtime_error&) {
+            break;
+        }
+    }
+    REQUIRE(ascending == std::vector<std::string>{"30", "35", "40", "60", "70", "80"});
+    REQUIRE(tree.search(40) == nullptr);
+
+    BinaryTree<int> numbers;
+    for (int i = 0; i < 100; ++i) numbers.insert((i * 37) % 100, (i * 37) % 100);
+    BinaryTree<int> copy = numbers;
+    for (int expected = 99; expected >= 90; --expected) REQUIRE(copy.popMax() == expected);
+    REQUIRE(copy.maxRef() == 89);
+    REQUIRE(copy.minRef() == 0);
+    REQUIRE(numbers.getMax() == 99);
+
+    numbers.balance();
+    REQUIRE(numbers.popMin() == 0);
+    REQUIRE(numbers.minRef() == 1);
+}
+
+TEST_CASE("BinaryTree: cached depth follows inserts, removals and rebuilds") {
+    BinaryTree<int> tree;
+    REQUIRE(tree.GetDepth() == 0);
+    for (int i = 1; i <= 5; ++i) {
+        tree.insert(i, i);
+        REQUIRE(tree.GetDepth() == i);
+    }
+    tree.insert(3, 30); // перезапись не меняет глубину
+    REQUIRE(tree.GetDepth() == 5);
+
+    REQUIRE(tree.remove(5));
+    REQUIRE(tree.GetDepth() == 4);
+    REQUIRE(tree.popMin() == 1);
+    REQUIRE(tree.GetDepth() == 3);
+
+    for (int i = 10; i < 100; ++i) tree.insert(i, i);
+    tree.balance();
+    REQUIRE(tree.GetDepth() == 7); // 93 узла
+
+    BinaryTree<int> copy = tree;
+    REQUIRE(copy.GetDepth() == 7);
+    copy.insert(1000, 1000);
+    REQUIRE(copy.GetDepth() == 8);
+    BinaryTree<int> moved = std::move(copy);
+    REQUIRE(moved.GetDepth() == 8);
+    REQUIRE(copy.GetDepth() == 0);
+}
+
+TEST_CASE("RandomTree: exact depth, shapes and key distributions") {
+    const std::vector<std::pair<int, int>> sizes = {
+        {1, 1}, {2, 2}, {7, 3}, {7, 7}, {100, 7}, {100, 50}, {1000, 10}, {1000, 999}, {5000, 40}};
+    for (auto shape : {TreeShape::Balanced, TreeShape::Random, TreeShape::Skewed}) {
+        for (auto dist : {KeyDistribution::Uniform, KeyDistribution::Zipf, KeyDistribution::Sequential, KeyDistribution::Clustered}) {
+            for (auto [nodes, depth] : sizes) {
+                BinaryTree<int> tree = RandomTree(nodes, depth, dist, shape, false, 12345);
+                REQUIRE(tree.isValidTreeString(tree.toString()));
+                REQUIRE(tree.GetDepth() == depth);
+                int rootKey = *tree.findByPath("");
+                REQUIRE(tree.extractSubtree(rootKey).GetDepth() == depth); // честный пересчёт глубины
+            }
+        }
+    }
+
+    REQUIRE(RandomTree(1000, 10, KeyDistribution::Sequential, TreeShape::Balanced).getMax() == 999);
+    REQUIRE_THROWS_AS(RandomTree(1000, 9), std::invalid_argument); // в 9 уровней 1000 узлов не влезает
+    REQUIRE_THROWS_AS(RandomTree(10, 11), std::invalid_argument);
+
+    ThreadPool::Instance().SetThreadCount(4);
+    BinaryTree<int> parallel = RandomTree(50000, 100, KeyDistribution::Zipf, TreeShape::Random, true, 7);
+    ThreadPool::Instance().SetThreadCount(std::thread::hardware_concurrency());
+    BinaryTree<int> serial = RandomTree(50000, 100, KeyDistribution::Zipf, TreeShape::Random, false, 7);
+    REQUIRE(parallel == serial); // форма и ключи зависят только от seed
+
+    // предельная глубина: дерево строится, копируется, сравнивается и удаляется без переполнения стека
+    const int maxDepth = BinaryTree<int>::kMaxBuildDepth;
+    for (auto shape : {TreeShape::Random, TreeShape::Skewed}) {
+        BinaryTree<int> deep = RandomTree(100000, maxDepth, KeyDistribution::Sequential, shape, false, 3);
+        REQUIRE(deep.GetDepth() == maxDepth);
+        long long sum = 0;
+        for (int v : deep) sum += v;
+        REQUIRE(sum == 99999LL * 100000 / 2);
+        REQUIRE(*deep.search(99999) == 99999);
+        BinaryTree<int> copied = deep;
+        REQUIRE(copied == deep);
+    }
+    REQUIRE_THROWS_AS(RandomTree(100000, maxDepth + 1), std::invalid_argument);
+}
+
+TEST_CASE("BinaryTree: splay access mode") {
+    BinaryTree<int> tree;
+    tree.setAccessMode(AccessMode::Splay);
+    REQUIRE(tree.getAccessMode() == AccessMode::Splay);
+    for (int i = 1; i <= 100; ++i) tree.insert(i, i * 10);
+    REQUIRE(*tree.findByPath("") == 1000); // последний вставленный - в корне
+    REQUIRE(tree.GetDepth() == 100);
+
+    REQUIRE(*tree.search(1) == 10);
+    REQUIRE(*tree.findByPath("") == 10);
+    REQUIRE(tree.GetDepth() < 100); // zig-zig примерно вдвое укорачивает путь
+    REQUIRE(tree.search(1000) == nullptr);
+    REQUIRE(*tree.findByPath("") == 1000); // при промахе поднят ближайший ключ
+    REQUIRE(tree.isValidTreeString(tree.toString()));
+
+    // через константную ссылку дерево не меняется
+    const BinaryTree<int>& view = tree;
+    REQUIRE(*view.search(50) == 500);
+    REQUIRE(*tree.findByPath("") == 1000);
+
+    // форма другая, порядок ключей тот же
+    BinaryTree<int> reference;
+    for (int i = 1; i <= 100; ++i) reference.insert(i, i * 10);
+    std::vector<int> splayed, expected;
+    tree.traverseLKP([&](const int& v) { splayed.push_back(v); });
+    reference.traverseLKP([&](const int& v) { expected.push_back(v); });
+    REQUIRE(splayed == expected);
+    REQUIRE(tree.getMin() == 10);
+    REQUIRE(tree.getMax() == 1000);
+    REQUIRE(tree.remove(50));
+    REQUIRE(tree.search(50) == nullptr);
+    REQUIRE(*tree.search(51) == 510);
+
+    BinaryTree<int> copy = tree;
+    REQUIRE(copy.getAccessMode() == AccessMode::Splay);
+    reference.search(1);
+    REQUIRE(*reference.findByPath("") == 10); // в режиме Static корень не меняется
+}
+
+TEST_CASE("BinaryTree: scapegoat mode bounds the depth") {
+    const int N = 20000;
+    const int bound = static_cast<int>(std::floor(std::log(N) / std::log(1.5))) + 1;
+
+    BinaryTree<int> tree;
+    tree.setAccessMode(AccessMode::Scapegoat);
+    tree.insert(0, 0);
+    int* first = tree.search(0);
+    for (int i = 1; i < N; ++i) tree.insert(i, i); // по возрастанию - худший случай для обычной вставки
+    REQUIRE(tree.GetDepth() <= bound);
+    REQUIRE(tree.search(0) == first); // узлы не пересоздаются
+    REQUIRE(tree.getMin() == 0);
+    REQUIRE(tree.getMax() == N - 1);
+    REQUIRE(tree.isValidTreeString(tree.toString()));
+
+    BinaryTree<int> plain;
+    for (int i = 0; i < N; i += 97) plain.insert(i, i);
+    BinaryTree<int> expected = plain;
+    int removed = 0;
+    for (int i = 0; i < N; ++i)
+        if (i % 97 != 0) removed += tree.remove(i);
+    REQUIRE(removed == N - (N + 96) / 97);
+    REQUIRE(tree.GetDepth() <= static_cast<int>(std::floor(std::log(N / 97 + 1) / std::log(1.5))) + 1);
+    std::vector<int> left, right;
+    tree.traverseLKP([&](const int& v) { left.push_back(v); });
+    expected.traverseLKP([&](const int& v) { right.push_back(v); });
+    REQUIRE(left == right);
+    REQUIRE(tree.popMin() == 0);
+
+    // включение режима на вырожденном дереве сразу его перестраивает
+    BinaryTree<int> chain;
+    for (int i = 0; i < 1000; ++i) chain.insert(i, i);
+    REQUIRE(chain.GetDepth() == 1000);
+    chain.setAccessMode(AccessMode::Scapegoat);
+    REQUIRE(chain.GetDepth() == 10);
+    chain.insert(1000, 1000);
+    REQUIRE(BinaryTree<int>::fromString(chain.toString()) == chain); // хеши поддерживаются при перестройках
+
+    // split и join обходят вставку и удаление - граница глубины восстанавливается отдельно
+    auto depthBound = [](int n) { return static_cast<int>(std::floor(std::log(n) / std::log(1.5))) + 1; };
+    for (int key : {3, 50, 900}) {
+        BinaryTree<int> source = chain;
+        source.setAccessMode(AccessMode::Scapegoat);
+        auto [low, high] = source.split(key);
+        REQUIRE(low.getAccessMode() == AccessMode::Scapegoat);
+        REQUIRE(low.GetDepth() <= depthBound(key));
+        REQUIRE(high.GetDepth() <= depthBound(1001 - key));
+        REQUIRE(std::distance(low.begin(), low.end()) == key);
+        REQUIRE(std::distance(high.begin(), high.end()) == 1001 - key);
+    }
+    BinaryTree<int> small, tail;
+    small.setAccessMode(AccessMode::Scapegoat);
+    for (int i = 0; i < 10; ++i) small.insert(i, i);
+    for (int i = 10; i < 1010; ++i) tail.insert(i, i); // обычное вырожденное дерево
+    BinaryTree<int> joined = BinaryTree<int>::join(std::move(small), std::move(tail));
+    REQUIRE(joined.GetDepth() <= depthBound(1010));
+    REQUIRE(joined.getMin() == 0);
+    REQUIRE(joined.getMax() == 1009);
+    REQUIRE(BinaryTree<int>::fromString(joined.toString()) == joined);
+
+    // присваивание: режим остаётся у дерева слева, а форма приходит вырожденной
+    BinaryTree<int> longChain;
+    for (int i = 0; i < 2000; ++i) longChain.insert(i, i);
+    BinaryTree<int> assigned, moved;
+    assigned.setAccessMode(AccessMode::Scapegoat);
+    moved.setAccessMode(AccessMode::Scapegoat);
+    assigned = longChain;
+    REQUIRE(longChain.GetDepth() == 2000);
+    REQUIRE(assigned.GetDepth() <= depthBound(2000));
+    REQUIRE(assigned == BinaryTree<int>::fromString(assigned.toString()));
+    moved = std::move(longChain);
+    REQUIRE(moved.GetDepth() <= depthBound(2000));
+    REQUIRE(moved.getMin() == 0);
+    REQUIRE(moved.getMax() == 1999);
+}
+
+TEST_CASE("BinaryTree: split, join and set operations") {
+    BinaryTree<int> tree;
+    for (int i = 0; i < 100; ++i) tree.insert(i, i * 10);
+    tree.balance();
+    tree.enableValueIndex();
+
+    auto [low, high] = tree.split(40);
+    REQUIRE(tree.GetDepth() == 0);
+    REQUIRE(low.getMin() == 0);
+    REQUIRE(low.getMax() == 390);
+    REQUIRE(high.getMin() == 400); // ключ разреза уходит вправо
+    REQUIRE(high.getMax() == 990);
+    REQUIRE(low.search(40) == nullptr);
+    REQUIRE(high.containsNode(500));
+    REQUIRE_FALSE(high.containsNode(390));
+    REQUIRE(BinaryTree<int>::fromString(high.toString()) == high); // хеши после перецепления верные
+
+    auto [empty, all] = high.split(-5);
+    REQUIRE(empty.GetDepth() == 0);
+    REQUIRE(all.getMin() == 400);
+
+    REQUIRE_THROWS_AS(BinaryTree<int>::join(BinaryTree<int>(all), BinaryTree<int>(low)), std::invalid_argument);
+    BinaryTree<int> joined = BinaryTree<int>::join(std::move(low), std::move(all));
+    REQUIRE(joined.getMin() == 0);
+    REQUIRE(joined.getMax() == 990);
+    REQUIRE(joined.reduce(0, [](const int& a, const int& b) { return a + b; }) == 49500);
+    REQUIRE(BinaryTree<int>::fromString(joined.toString()) == joined);
+    joined.insert(100, 1000);
+    REQUIRE(*joined.search(100) == 1000);
+
+    // с CountAugment размер части берётся из сводки корня
+    BinaryTree<int, CountAugment> counted;
+    for (int i = 0; i < 1000; ++i) counted.insert(i * 7 % 1000, i);
+    auto [few, many] = counted.split(100);
+    REQUIRE(few.aggregate(0, 1000) == 100);
+    REQUIRE(std::distance(many.begin(), many.end()) == 900);
+    BinaryTree<int, CountAugment> whole = BinaryTree<int, CountAugment>::join(std::move(few), std::move(many));
+    REQUIRE(whole.aggregate(std::numeric_limits<int>::min(), std::numeric_limits<int>::max()) == 1000);
+    REQUIRE(whole.eraseRange(10, 19) == 10);
+    REQUIRE(whole.aggregate(0, 999) == 990);
+
+    BinaryTree<int> evens, threes;
+    for (int i = 0; i < 60; i += 2) evens.insert(i, i);
+    for (int i = 0; i < 60; i += 3) threes.insert(i, -i);
+
+    auto keys = [](const BinaryTree<int>& t) {
+        std::vector<int> out;
+        t.traverseLKP([&](const int& v) { out.push_back(v); });
+        return out;
+    };
+    std::vector<int> expected;
+    for (int i = 0; i < 60; ++i) {
+        if (i % 3 == 0) expected.push_back(-i); // побеждает other
+        else if (i % 2 == 0) expected.push_back(i);
+    }
+    BinaryTree<int> united = evens.unionWith(threes);
+    REQUIRE(keys(united) == expected);
+    REQUIRE(united.getMin() == 0);
+    REQUIRE(BinaryTree<int>::fromString(united.toString()) == united);
+
+    expected.clear();
+    for (int i = 0; i < 60; i += 6) expected.push_back(i);
+    REQUIRE(keys(evens.intersect(threes)) == expected);
+
+    expected.clear();
+    for (int i = 0; i < 60; i += 2) if (i % 3 != 0) expected.push_back(i);
+    BinaryTree<int> diff = evens.difference(threes);
+    REQUIRE(keys(diff) == expected);
+    REQUIRE(diff.getMax() == 58);
+    REQUIRE(keys(evens).size() == 30); // исходные деревья не меняются
+    REQUIRE(keys(evens.difference(BinaryTree<int>())) == keys(evens));
+    REQUIRE(keys(BinaryTree<int>().intersect(evens)).empty());
+
+    // большие деревья - параллельно, результат тот же
+    BinaryTree<int> a, b;
+    std::vector<std::pair<int, int>> itemsA, itemsB;
+    for (int i = 0; i < 100000; ++i) {
+        itemsA.push_back({i * 2, i});
+        itemsB.push_back({i * 3, i});
+    }
+    a.bulkLoad(itemsA);
+    b.bulkLoad(itemsB);
+    BinaryTree<int> serialUnion = a.unionWith(b), serialIntersect = a.intersect(b), serialDiff = a.difference(b);
+    ThreadPool::Instance().SetThreadCount(4);
+    REQUIRE(a.unionWith(b) == serialUnion);
+    REQUIRE(a.intersect(b) == serialIntersect);
+    REQUIRE(a.difference(b) == serialDiff);
+    ThreadPool::Instance().SetThreadCount(std::thread::hardware_concurrency());
+    REQUIRE(serialIntersect.getMax() == 99999); // ключ 199998 - общий максимум
+
+    // поглощающие версии: тот же результат без копий, входы пустеют
+    BinaryTree<int> a2 = a, b2 = b;
+    BinaryTree<int> consumedUnion = BinaryTree<int>::unionWith(std::move(a2), std::move(b2));
+    REQUIRE(consumedUnion == serialUnion);
+    REQUIRE(a2 == BinaryTree<int>());
+    REQUIRE(b2 == BinaryTree<int>());
+    a2 = a;
+    b2 = b;
+    REQUIRE(BinaryTree<int>::intersect(std::move(a2), std::move(b2)) == serialIntersect);
+    a2 = a;
+    b2 = b;
+    BinaryTree<int> consumedDiff = BinaryTree<int>::difference(std::move(a2), std::move(b2));
+    REQUIRE(consumedDiff == serialDiff);
+    REQUIRE(consumedDiff.getMin() == 1); // ключ 2
+    REQUIRE(consumedDiff.search(6) == nullptr);
+    REQUIRE(keys(BinaryTree<int>::unionWith(BinaryTree<int>(evens), BinaryTree<int>())) == keys(evens));
+}
+
+TEST_CASE("BinaryTree: eraseRange and eraseIf") {
+    auto values = [](const BinaryTree<int>& t) {
+        std::vector<int> out;
+        t.traverseLKP([&](const int& v) { out.push_back(v); });
+        return out;
+    };
+
+    BinaryTree<int> tree;
+    for (int i = 0; i < 100; ++i) tree.insert(i, i);
+    tree.balance();
+    tree.enableValueIndex();
+
+    REQUIRE(tree.eraseRange(20, 29) == 10);
+    REQUIRE(tree.search(20) == nullptr);
+    REQUIRE(tree.search(29) == nullptr);
+    REQUIRE(*tree.search(19) == 19);
+    REQUIRE(*tree.search(30) == 30);
+    REQUIRE_FALSE(tree.containsNode(25));
+    std::string shape = tree.toString();
+    int depth = tree.GetDepth();
+    REQUIRE(tree.eraseRange(25, 27) == 0);
+    REQUIRE(tree.eraseRange(10, 5) == 0);
+    REQUIRE(tree.toString() == shape); // пустой диапазон форму не меняет
+    REQUIRE(tree.GetDepth() == depth);
+    REQUIRE(BinaryTree<int>::fromString(tree.toString()) == tree);
+    REQUIRE(tree.eraseRange(30, 30) == 1);
+    REQUIRE(tree.GetDepth() == BinaryTree<int>::fromString(tree.toString()).GetDepth());
+
+    REQUIRE(tree.eraseRange(-100, 4) == 5); // края дерева
+    REQUIRE(tree.getMin() == 5);
+    REQUIRE(tree.eraseRange(90, 1000) == 10);
+    REQUIRE(tree.getMax() == 89);
+    REQUIRE(values(tree).size() == 74);
+
+    REQUIRE(tree.eraseIf([](const int& v) { return v % 2 == 1; }) == 38);
+    REQUIRE(tree.getMin() == 6);
+    REQUIRE(tree.getMax() == 88);
+    REQUIRE(tree.containsNode(50));
+    REQUIRE_FALSE(tree.containsNode(51));
+    for (int v : values(tree)) REQUIRE(v % 2 == 0);
+    REQUIRE(BinaryTree<int>::fromString(tree.toString()) == tree);
+
+    REQUIRE(tree.eraseIf([](const int&) { return false; }) == 0);
+    REQUIRE(tree.eraseRange(std::numeric_limits<int>::min(), std::numeric_limits<int>::max()) == 36);
+    REQUIRE(tree.GetDepth() == 0);
+    REQUIRE_THROWS_AS(tree.getMin(), std::runtime_error);
+
+    // большое дерево: вырезанный кусок освобождается в фоне, фильтр идёт параллельно
+    BinaryTree<int> big;
+    big.setDeferredDestroy(true);
+    std::vector<std::pair<int, int>> items;
+    for (int i = 0; i < 200000; ++i) items.push_back({i, i});
+    big.bulkLoad(items);
+    REQUIRE(big.eraseRange(1000, 150999) == 150000);
+    ThreadPool::Instance().SetThreadCount(4);
+    REQUIRE(big.eraseIf([](const int& v) { return v % 3 == 0; }) == 16667);
+    ThreadPool::Instance().SetThreadCount(std::thread::hardware_concurrency());
+    REQUIRE(big.getMin() == 1);
+    REQUIRE(big.getMax() == 199999);
+    REQUIRE(values(big).size() == 33333);
+    Reclaimer::Instance().Wait();
+
+    // склейка после вырезания не выводит Scapegoat за границу глубины
+    BinaryTree<int> goat;
+    goat.setAccessMode(AccessMode::Scapegoat);
+    for (int i = 0; i < 3000; ++i) goat.insert(i, i);
+    int left = 3000;
+    for (int lo = 7; lo < 3000; lo += 29) {
+        left -= goat.eraseRange(lo, lo + 2);
+        REQUIRE(goat.GetDepth() - 1 <= static_cast<int>(std::floor(std::log(left) / std::log(1.5))));
+    }
+    REQUIRE(static_cast<int>(values(goat).size()) == left);
+    REQUIRE(goat.GetDepth() == BinaryTree<int>::fromString(goat.toString()).GetDepth());
+}
+
+TEST_CASE("BinaryTree: remove relinks the successor instead of copying it") {
+    BinaryTree<Student> tree;
+    for (int key : {50, 30, 70, 20, 40, 60, 80, 65}) tree.insert(key, Student("S" + std::to_string(key), 20, key, "B1", 4.0));
+    tree.enableValueIndex();
+    Student* successor = tree.search(60);
+    Student* deepSuccessor = tree.search(65);
+
+    REQUIRE(tree.remove(50)); // два ребёнка, преемник 60 - в корень
+    REQUIRE(tree.search(60) == successor); // тот же узел, значение не копировалось
+    REQUIRE(tree.findByPath("") == successor);
+    REQUIRE(tree.search(50) == nullptr);
+    REQUIRE(tree.containsNode(Student("S60", 20, 60, "B1", 4.0)));
+    REQUIRE_FALSE(tree.containsNode(Student("S50", 20, 50, "B1", 4.0)));
+
+    REQUIRE(tree.remove(60)); // правый ребёнок преемника поднимается на его место
+    REQUIRE(tree.findByPath("") == deepSuccessor);
+    REQUIRE(tree.findByPath("P")->name == "S70");
+    REQUIRE(tree.findByPath("PL") == nullptr);
+    REQUIRE(tree.findByPath("L")->name == "S30");
+
+    REQUIRE(tree.remove(20));
+    REQUIRE(tree.getMin().name == "S30");
+    REQUIRE(tree.remove(80));
+    REQUIRE(tree.getMax().name == "S70");
+
+    BinaryTree<int> ints;
+    for (int key : {50, 30, 70, 20, 40, 60, 80, 65}) ints.insert(key, key);
+    REQUIRE(ints.remove(50));
+    REQUIRE(BinaryTree<int>::fromString(ints.toString()) == ints); // хеши на пути к преемнику пересчитаны
+}
+
+TEST_CASE("SplitBinaryTree: keys and values stored apart") {
+    SplitBinaryTree<Student> tree;
+    REQUIRE(tree.search(1) == nullptr);
+    REQUIRE_THROWS_AS(tree.getMin(), std::runtime_error);
+    for (int key : {50, 30, 70, 20, 40, 60, 80})
+        tree.insert(key, Student("S" + std::to_string(key), 20, key, "B1", 4.0));
+    REQUIRE(tree.getSize() == 7);
+    REQUIRE(tree.search(40)->name == "S40");
+    REQUIRE(tree.getMin().name == "S20");
+    REQUIRE(tree.getMax().name == "S80");
+
+    tree.insert(40, Student("New", 21, 40, "B2", 3.0)); // перезапись
+    REQUIRE(tree.getSize() == 7);
+    REQUIRE(tree.search(40)->name == "New");
+
+    REQUIRE(tree.remove(50)); // два ребёнка
+    REQUIRE_FALSE(tree.remove(50));
+    REQUIRE(tree.search(50) == nullptr);
+    tree.insert(55, Student("S55", 20, 55, "B1", 4.0)); // занимает освободившуюся ячейку
+    std::vector<int> ids;
+    tree.traverseLKP([&](const Student& s) { ids.push_back(s.id); });
+    REQUIRE(ids == std::vector<int>{20, 30, 40, 55, 60, 70, 80});
+
+    SplitBinaryTree<Student> copy = tree;
+    copy.remove(20);
+    REQUIRE(tree.search(20) != nullptr);
+    REQUIRE(copy.getMin().name == "S30");
+    SplitBinaryTree<Student> moved = std::move(copy);
+    REQUIRE(moved.getSize() == 6);
+    moved.clear();
+    REQUIRE(moved.getSize() == 0);
+}
+
+TEST_CASE("CompactBinaryTree: 32-bit links, copy and raw save/load") {
+    auto values = [](const CompactBinaryTree<double>& t) {
+        std::vector<double> out;
+        t.traverseLKP([&](const double& v) { out.push_back(v); });
+        return out;
+    };
+
+    CompactBinaryTree<double> tree;
+    REQUIRE(tree.search(1) == nullptr);
+    REQUIRE_THROWS_AS(tree.getMax(), std::runtime_error);
+    std::vector<int> keys(1000);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::shuffle(keys.begin(), keys.end(), std::mt19937{3});
+    for (int key : keys) tree.insert(key, key * 0.5);
+    REQUIRE(tree.getSize() == 1000);
+    REQUIRE(*tree.search(500) == 250.0);
+    tree.insert(500, -1.0);
+    REQUIRE(*tree.search(500) == -1.0);
+
+    int removed = 0;
+    for (int key = 0; key < 1000; key += 2) removed += tree.remove(key);
+    REQUIRE(removed == 500);
+    REQUIRE_FALSE(tree.remove(0));
+    REQUIRE(tree.getSize() == 500);
+    REQUIRE(tree.getMin() == 0.5);
+    REQUIRE(tree.getMax() == 499.5);
+    tree.insert(-5, -2.5); // берёт освобождённый узел
+    REQUIRE(tree.getMin() == -2.5);
+
+    CompactBinaryTree<double> copy = tree; // копируется как массив
+    copy.remove(-5);
+    REQUIRE(*tree.search(-5) == -2.5);
+    REQUIRE(copy.getSize() == 500);
+
+    std::stringstream stream;
+    tree.save(stream);
+    CompactBinaryTree<double> loaded = CompactBinaryTree<double>::load(stream);
+    REQUIRE(values(loaded) == values(tree));
+    REQUIRE(loaded.getSize() == tree.getSize());
+    loaded.insert(2000, 1.0);
+    REQUIRE(loaded.getMax() == 1.0);
+
+    std::stringstream truncated(stream.str().substr(0, 40));
+    REQUIRE_THROWS_AS(CompactBinaryTree<double>::load(truncated), std::invalid_argument);
+    std::string corrupted = stream.str();
+    corrupted.replace(24, 4, "\xfe\xff\xff\xff"); // left первого узла (после 20 байт заголовка и key) - за пределами массива
+    std::stringstream badLink(corrupted);
+    REQUIRE_THROWS_AS(CompactBinaryTree<double>::load(badLink), std::invalid_argument);
+    corrupted = stream.str();
+    corrupted.replace(24, 4, std::string(4, '\0')); // узел 0 ссылается сам на себя (в дереве или в списке свободных)
+    std::stringstream cycle(corrupted);
+    REQUIRE_THROWS_AS(CompactBinaryTree<double>::load(cycle), std::invalid_argument);
+    corrupted = stream.str();
+    corrupted[16] = static_cast<char>(corrupted[16] + 1); // size (после count и двух номеров) на один больше живых узлов
+    std::stringstream wrongSize(corrupted);
+    REQUIRE_THROWS_AS(CompactBinaryTree<double>::load(wrongSize), std::invalid_argument);
+
+    CompactBinaryTree<std::string> words; // без save/load подходит любой T
+    words.insert(2, "b");
+    words.insert(1, "a");
+    REQUIRE(words.remove(2));
+    REQUIRE(words.getMax() == "a");
+    words.clear();
+    REQUIRE(words.getSize() == 0);
+}
+
+TEST_CASE("BinaryTree: threaded scans and iterators") {
+    BinaryTree<int> tree;
+    std::vector<int> keys(2000);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::shuffle(keys.begin(), keys.end(), std::mt19937{11});
+    for (int key : keys) tree.insert(key, key * 2);
+    const std::string shape = tree.toString();
+
+    std::vector<int> plain, threaded, reversed, iterated;
+    tree.traverseLKP([&](const int& v) { plain.push_back(v); });
+    tree.setThreadedScans(true);
+    tree.traverseLKP([&](const int& v) { threaded.push_back(v); });
+    tree.traversePKL([&](const int& v) { reversed.push_back(v); });
+    REQUIRE(threaded == plain);
+    REQUIRE(std::equal(reversed.rbegin(), reversed.rend(), plain.begin(), plain.end()));
+    REQUIRE(tree.toString() == shape); // нити убраны
+
+    // исключение посреди обхода не оставляет нитей в дереве
+    int visited = 0;
+    REQUIRE_THROWS_AS(tree.traverseLKP([&](const int&) {
+        if (++visited == 1000) throw std::runtime_error("stop");
+    }), std::runtime_error);
+    REQUIRE(visited == 1000);
+    REQUIRE(tree.toString() == shape);
+    REQUIRE(BinaryTree<int>::fromString(tree.toString()) == tree);
+
+    tree.balance(); // сбор узлов тоже идёт без стека
+    REQUIRE(tree.GetDepth() == 11);
+    BinaryTree<int> evens = tree.where([](const int& v) { return v % 4 == 0; });
+    REQUIRE(evens.getMax() == 3996);
+
+    for (int v : tree) iterated.push_back(v);
+    REQUIRE(iterated == plain);
+    auto it = tree.begin();
+    REQUIRE(it.key() == 0);
+    ++it;
+    REQUIRE(it.key() == 1);
+    REQUIRE(*it++ == 2);
+    REQUIRE(*it == 4);
+    REQUIRE(std::distance(tree.begin(), tree.end()) == 2000);
+    REQUIRE(std::find(tree.begin(), tree.end(), 3000).key() == 1500);
+
+    BinaryTree<int> empty;
+    REQUIRE(empty.begin() == empty.end());
+}
+
+TEST_CASE("BinaryTree: adaptive flat array for read-mostly trees") {
+    BinaryTree<int> tree;
+    tree.setAdaptive(true);
+    for (int i = 0; i < 400; ++i) tree.insert(i * 3, i);
+    REQUIRE_FALSE(tree.hasFlatIndex());
+
+    int found = 0;
+    for (int i = 0; i < 200; ++i) found += tree.search(i * 3) != nullptr; // 32 + 400 / 4 = 132 чтения до перестройки
+    REQUIRE(found == 200);
+    REQUIRE(tree.hasFlatIndex());
+    REQUIRE(*tree.search(300) == 100);
+    REQUIRE(tree.search(301) == nullptr);
+    REQUIRE(tree.search(-1) == nullptr);
+    REQUIRE(tree.search(5000) == nullptr);
+    *tree.search(3) = 77; // указатели ведут в те же узлы
+    REQUIRE(*tree.findByPath("") == 0);
+    REQUIRE(tree.getMin() == 0);
+
+    tree.insert(3, 1); // перезапись ключей не меняет
+    REQUIRE(tree.hasFlatIndex());
+    tree.insert(1, 1);
+    REQUIRE_FALSE(tree.hasFlatIndex()); // запись - обратно к узлам
+    REQUIRE(*tree.search(1) == 1);
+
+    // при частых записях массив не строится
+    int matched = 0;
+    for (int i = 0; i < 1000; ++i) {
+        tree.insert(2000 + i * 3, i);
+        matched += *tree.search(2000 + i * 3) == i;
+    }
+    REQUIRE(matched == 1000);
+    REQUIRE_FALSE(tree.hasFlatIndex());
+
+    for (int i = 0; i < 2000; ++i) tree.search(i);
+    REQUIRE(tree.hasFlatIndex());
+    REQUIRE(tree.remove(300));
+    REQUIRE_FALSE(tree.hasFlatIndex());
+    for (int i = 0; i < 2000; ++i) tree.search(i);
+    REQUIRE(tree.search(300) == nullptr);
+    REQUIRE(tree.eraseRange(0, 99) == 35);
+    REQUIRE(tree.search(99) == nullptr);
+
+    BinaryTree<int> moved = std::move(tree);
+    REQUIRE(tree.search(102) == nullptr);
+    REQUIRE(*moved.search(102) == 34);
+
+    // константный поиск из нескольких потоков
+    const BinaryTree<int>& view = moved;
+    ThreadPool::Instance().SetThreadCount(4);
+    std::atomic<int> hits{0};
+    ThreadPool::Instance().ParallelFor(0, 4000, [&](size_t i) {
+        if (view.search(static_cast<int>(i))) ++hits;
+    });
+    ThreadPool::Instance().SetThreadCount(std::thread::hardware_concurrency());
+    REQUIRE(hits == 365 + 667);
+}
+
+TEST_CASE("IntKeyMap: radix map over int keys") {
+    IntKeyMap<std::string> map;
+    REQUIRE(map.search(0) == nullptr);
+    REQUIRE_THROWS_AS(map.getMin(), std::runtime_error);
+    int out = 0;
+    REQUIRE_FALSE(map.successor(0, out));
+
+    const std::vector<int> keys = {0, -1, 1, 255, 256, 65536, -65536, 1 << 30,
+                                   std::numeric_limits<int>::min(), std::numeric_limits<int>::max()};
+    for (int key : keys) map.insert(key, std::to_string(key));
+    REQUIRE(map.getSize() == 10);
+    for (int key : keys) REQUIRE(*map.search(key) == std::to_string(key));
+    REQUIRE(map.search(2) == nullptr);
+    map.insert(256, "x");
+    REQUIRE(*map.search(256) == "x");
+    REQUIRE(map.getSize() == 10);
+
+    std::vector<int> sorted = keys, traversed;
+    std::sort(sorted.begin(), sorted.end());
+    map.traverse([&](int key, const std::string&) { traversed.push_back(key); });
+    REQUIRE(traversed == sorted);
+    REQUIRE(map.getMin() == std::to_string(std::numeric_limits<int>::min()));
+    REQUIRE(map.getMax() == std::to_string(std::numeric_limits<int>::max()));
+
+    for (size_t i = 0; i + 1 < sorted.size(); ++i) {
+        REQUIRE(map.successor(sorted[i], out));
+        REQUIRE(out == sorted[i + 1]);
+        REQUIRE(map.predecessor(sorted[i + 1], out));
+        REQUIRE(out == sorted[i]);
+    }
+    REQUIRE_FALSE(map.successor(std::numeric_limits<int>::max(), out));
+    REQUIRE_FALSE(map.predecessor(std::numeric_limits<int>::min(), out));
+    REQUIRE(map.successor(2, out));
+    REQUIRE(out == 255);
+    REQUIRE(map.predecessor(65535, out));
+    REQUIRE(out == 256);
+
+    REQUIRE(map.remove(256));
+    REQUIRE_FALSE(map.remove(256));
+    REQUIRE(map.search(256) == nullptr);
+    REQUIRE(map.successor(255, out));
+    REQUIRE(out == 65536);
+    REQUIRE(map.remove(std::numeric_limits<int>::min()));
+    REQUIRE(map.getMin() == "-65536");
+    REQUIRE(map.getSize() == 8);
+
+    // сверка с BinaryTree на случайных операциях
+    IntKeyMap<int> radix;
+    BinaryTree<int> tree;
+    std::mt19937 rng(5);
+    std::uniform_int_distribution<int> pick(-5000, 5000);
+    int mismatches = 0;
+    for (int i = 0; i < 20000; ++i) {
+        int key = pick(rng);
+        if (i % 3 == 0) mismatches += radix.remove(key) != tree.remove(key);
+        else {
+            radix.insert(key, i);
+            tree.insert(key, i);
+        }
+    }
+    std::vector<int> a, b;
+    radix.traverseLKP([&](const int& v) { a.push_back(v); });
+    tree.traverseLKP([&](const int& v) { b.push_back(v); });
+    REQUIRE(mismatches == 0);
+    REQUIRE(a == b);
+
+    IntKeyMap<int> moved = std::move(radix);
+    REQUIRE(moved.getSize() == static_cast<int>(b.size()));
+    REQUIRE(radix.getSize() == 0);
+    moved.clear();
+    REQUIRE(moved.search(0) == nullptr);
+}
+
+TEST_CASE("BinaryTree: Bloom filter in front of search") {
+    BloomFilter filter(1000);
+    for (int i = 0; i < 1000; ++i) filter.add(i * 7);
+    int falseNegatives = 0, falsePositives = 0;
+    for (int i = 0; i < 1000; ++i) {
+        falseNegatives += !filter.mayContain(i * 7);
+        falsePositives += filter.mayContain(i * 7 + 1);
+    }
+    REQUIRE(falseNegatives == 0);
+    REQUIRE(falsePositives < 50);
+
+    BinaryTree<int> tree;
+    for (int i = 0; i < 500; ++i) tree.insert(i * 2, i);
+    tree.enableKeyFilter();
+    int found = 0;
+    for (int i = 0; i < 1000; ++i) found += tree.search(i) != nullptr;
+    REQUIRE(found == 500);
+
+    for (int i = 500; i < 5000; ++i) tree.insert(i * 2, i); // фильтр перестраивается при росте
+    found = 0;
+    for (int i = 0; i < 10000; ++i) found += tree.search(i) != nullptr;
+    REQUIRE(found == 5000);
+
+    REQUIRE(tree.remove(10));
+    REQUIRE(tree.search(10) == nullptr);
+    tree.balance();
+    REQUIRE(tree.search(10) == nullptr);
+    REQUIRE(*tree.search(12) == 6);
+
+    BinaryTree<int> copy = tree;
+    REQUIRE(*copy.search(9998) == 4999);
+    BinaryTree<int> other;
+    other.enableKeyFilter();
+    other.insert(-1, -1);
+    other = std::move(copy);
+    REQUIRE(*other.search(9998) == 4999);
+    REQUIRE(other.search(-1) == nullptr);
+    REQUIRE(copy.search(9998) == nullptr);
+
+    auto [low, high] = other.split(5000);
+    REQUIRE(*high.search(5000) == 2500);
+    REQUIRE(low.search(5000) == nullptr);
+    tree.disableKeyFilter();
+    REQUIRE(*tree.search(12) == 6);
+}
+
+TEST_CASE("LearnedIndex: search over a frozen tree snapshot") {
+    BinaryTree<int> tree;
+    std::mt19937 rng(47);
+    std::uniform_int_distribution<int> gap(1, 1000);
+    std::vector<int> keys;
+    int key = -200000;
+    for (int i = 0; i < 20000; ++i) keys.push_back(key += (i % 1000 < 500 ? gap(rng) : 3)); // неравномерные ключи
+    std::vector<int> shuffled = keys;
+    std::shuffle(shuffled.begin(), shuffled.end(), rng);
+    for (int k : shuffled) tree.insert(k, k * 2);
+
+    auto items = tree.toSortedVector();
+    REQUIRE(items.size() == keys.size());
+    REQUIRE(items.front().first == keys.front());
+    REQUIRE(items.back().second == keys.back() * 2);
+
+    for (int epsilon : {1, 8, 64}) {
+        LearnedIndex<int> index = LearnedIndex<int>::fromTree(tree, epsilon);
+        REQUIRE(index.getSize() == keys.size());
+        REQUIRE(index.segmentCount() < keys.size());
+        for (int k : keys) {
+            const int* value = index.search(k);
+            REQUIRE(value != nullptr);
+            REQUIRE(*value == k * 2);
+        }
+        REQUIRE(index.search(keys.front() - 1) == nullptr);
+        REQUIRE(index.search(keys.back() + 1) == nullptr);
+        REQUIRE(index.search(keys[100] + 1) == (keys[101] == keys[100] + 1 ? index.search(keys[101]) : nullptr));
+    }
+
+    LearnedIndex<int> empty(std::vector<std::pair<int, int>>{});
+    REQUIRE(empty.search(0) == nullptr);
+    REQUIRE_THROWS_AS(LearnedIndex<int>({{2, 0}, {1, 0}}), std::invalid_argument);
+    REQUIRE_THROWS_AS(LearnedIndex<int>({{1, 0}}, 0), std::invalid_argument);
+}
+
+// окно по времени, ключ в дереве - начало окна
+struct TimeWindow {
+    int start;
+    int end;
+    int id;
+    bool operator==(const TimeWindow& other) const { return start == other.start && end == other.end && id == other.id; }
+};
+std::ostream& operator<<(std::ostream& os, const TimeWindow& w) { return os << w.start << "-" << w.end << ":" << w.id; }
+struct TimeWindowEnd {
+    int operator()(const TimeWindow& w) const { return w.end; }
+};
+using WindowTree = BinaryTree<TimeWindow, MaxEndpoint<TimeWindowEnd>>;
+
+static std::vector<int> overlappingIds(const std::map<int, TimeWindow>& windows, int lo, int hi) {
+    std::vector<int> ids;
+    for (const auto& [start, w] : windows)
+        if (start <= hi && w.end >= lo) ids.push_back(w.id);
+    return ids;
+}
+
+static std::vector<int> overlappingIds(const WindowTree& tree, int lo, int hi) {
+    std::vector<int> ids;
+    for (const auto& [start, w] : tree.overlapping(lo, hi)) ids.push_back(w.id);
+    return ids;
+}
+
+TEST_CASE("BinaryTree: interval augmentation and overlapping") {
+    WindowTree tree;
+    std::map<int, TimeWindow> reference;
+    std::mt19937 rng(48);
+    std::uniform_int_distribution<int> start(0, 10000), length(0, 300);
+    for (int i = 0; i < 2000; ++i) {
+        int s = start(rng);
+        TimeWindow w{s, s + length(rng), i};
+        tree.insert(s, w);
+        reference[s] = w;
+    }
+
+    auto check = [&]() {
+        for (int q = 0; q < 200; ++q) {
+            int lo = start(rng), hi = lo + length(rng);
+            REQUIRE(overlappingIds(tree, lo, hi) == overlappingIds(reference, lo, hi));
+        }
+    };
+    check();
+
+    SECTION("empty and degenerate queries") {
+        REQUIRE(tree.overlapping(20000, 30000).empty());
+        REQUIRE(tree.overlapping(5, 4).empty());
+        REQUIRE(WindowTree().overlapping(0, 100).empty());
+        tree.insert(-50, TimeWindow{-50, -10, -1});
+        REQUIRE(overlappingIds(tree, -10, -10) == std::vector<int>{-1});
+    }
+
+    SECTION("summaries survive removals, rebuilds and splits") {
+        for (int i = 0; i < 700; ++i) {
+            int s = start(rng);
+            REQUIRE(tree.remove(s) == (reference.erase(s) == 1));
+        }
+        check();
+        tree.balance();
+        check();
+        tree.eraseRange(3000, 4000);
+        reference.erase(reference.lower_bound(3000), reference.upper_bound(4000));
+        check();
+
+        auto [low, high] = tree.split(6000);
+        tree = WindowTree::join(std::move(low), std::move(high));
+        check();
+    }
+
+    SECTION("self-adjusting modes") {
+        tree.setAccessMode(AccessMode::Splay);
+        for (int i = 0; i < 300; ++i) {
+            int s = start(rng);
+            if (i % 2) {
+                tree.insert(s, TimeWindow{s, s + 5000, 5000 + i}); // длинное окно меняет максимумы на пути
+                reference[s] = TimeWindow{s, s + 5000, 5000 + i};
+            } else {
+                tree.search(s);
+            }
+        }
+        check();
+        tree.setAccessMode(AccessMode::Scapegoat);
+        for (int i = 0; i < 300; ++i) {
+            int s = start(rng);
+            tree.remove(s);
+            reference.erase(s);
+        }
+        check();
+    }
+
+    SECTION("rehash after editing through a pointer") {
+        auto first = reference.begin();
+        first->second.end += 100000;
+        tree.search(first->first)->end += 100000;
+        tree.rehash();
+        REQUIRE(overlappingIds(tree, 50000, 60000) == std::vector<int>{first->second.id});
+    }
+}
+
+struct StudentGpa {
+    double operator()(const Student& s) const { return s.gpa; }
+};
+struct IntValue {
+    int operator()(int v) const { return v; }
+};
+struct StringValue {
+    std::string operator()(const std::string& v) const { return v; }
+};
+
+TEST_CASE("BinaryTree: monoid augmentation and aggregate") {
+    SECTION("count and max GPA of students in an id range") {
+        BinaryTree<Student, AugmentPair<CountAugment, MaxOf<StudentGpa>>> tree;
+        std::map<int, Student> reference;
+        std::mt19937 rng(49);
+        std::uniform_int_distribution<int> id(0, 5000);
+        std::uniform_real_distribution<double> gpa(2.0, 5.0);
+        for (int i = 0; i < 1500; ++i) {
+            Student s("student" + std::to_string(i), 18 + i % 6, id(rng), "G" + std::to_string(i % 7), gpa(rng));
+            tree.insert(s.id, s);
+            reference[s.id] = s;
+        }
+        for (int i = 0; i < 400; ++i) {
+            int key = id(rng);
+            tree.remove(key);
+            reference.erase(key);
+        }
+
+        for (int q = 0; q < 300; ++q) {
+            int lo = id(rng), hi = lo + id(rng) / 10;
+            int count = 0;
+            double best = 0;
+            for (auto it = reference.lower_bound(lo); it != reference.end() && it->first <= hi; ++it) {
+                ++count;
+                best = std::max(best, it->second.gpa);
+            }
+            auto summary = tree.aggregate(lo, hi);
+            REQUIRE(summary.has_value() == (count > 0));
+            if (summary) {
+                REQUIRE(summary->first == count);
+                REQUIRE(summary->second == best);
+            }
+        }
+        REQUIRE(tree.aggregate(10, 9) == std::nullopt);
+        REQUIRE(tree.aggregate(std::numeric_limits<int>::min(), std::numeric_limits<int>::max())->first ==
+                static_cast<int>(reference.size()));
+    }
+
+    SECTION("sums stay exact under splay rotations") {
+        BinaryTree<int, SumOf<IntValue>> tree;
+        tree.setAccessMode(AccessMode::Splay);
+        for (int i = 1; i <= 1000; ++i) tree.insert((i * 37) % 1000, i);
+        long long expected = 0;
+        for (int i = 1; i <= 1000; ++i) {
+            tree.search(i % 1000);
+            if (((i * 37) % 1000) >= 100 && ((i * 37) % 1000) <= 599) expected += i;
+        }
+        REQUIRE(*tree.aggregate(100, 599) == expected);
+        REQUIRE(*tree.aggregate(5, 5) == *tree.search(5));
+    }
+
+    SECTION("non-commutative monoid keeps key order") {
+        BinaryTree<std::string, SumOf<StringValue>> tree;
+        std::string letters = "abcdefghijklmnopqrstuvwxyz";
+        std::vector<int> keys(letters.size());
+        std::iota(keys.begin(), keys.end(), 0);
+        std::shuffle(keys.begin(), keys.end(), std::mt19937(49));
+        for (int k : keys) tree.insert(k, std::string(1, letters[k]));
+        REQUIRE(*tree.aggregate(0, 25) == letters);
+        REQUIRE(*tree.aggregate(3, 9) == "defghij");
+        tree.balance();
+        tree.remove(5);
+        REQUIRE(*tree.aggregate(3, 9) == "degh" + std::string("ij"));
+    }
+}
+
+static std::vector<int> valuesInRange(const BinaryTree<int>& tree, int key) {
+    std::vector<int> values;
+    auto [first, last] = tree.equalRange(key);
+    for (auto it = first; it != last; ++it) values.push_back(*it);
+    return values;
+}
+
+TEST_CASE("BinaryTree: multimap mode") {
+    BinaryTree<int> tree;
+    tree.setMultimap(true);
+    REQUIRE(tree.isMultimap());
+    std::vector<int> keys = {50, 30, 70, 30, 50, 50, 10, 70, 30, 90};
+    for (size_t i = 0; i < keys.size(); ++i) tree.insert(keys[i], static_cast<int>(i));
+
+    REQUIRE(tree.count(30) == 3);
+    REQUIRE(tree.count(50) == 3);
+    REQUIRE(tree.count(40) == 0);
+    REQUIRE(valuesInRange(tree, 50) == std::vector<int>{0, 4, 5}); // порядок вставки
+    REQUIRE(valuesInRange(tree, 40).empty());
+    REQUIRE(*tree.search(30) == 1); // самый ранний
+    REQUIRE(tree.getMax() == 9);
+    REQUIRE(*tree.lowerBound(31) == 0);
+    REQUIRE(tree.upperBound(90) == tree.end());
+
+    SECTION("remove takes the earliest duplicate") {
+        REQUIRE(tree.remove(50));
+        REQUIRE(valuesInRange(tree, 50) == std::vector<int>{4, 5});
+        REQUIRE(*tree.search(50) == 4);
+        REQUIRE(tree.remove(50));
+        REQUIRE(tree.remove(50));
+        REQUIRE_FALSE(tree.remove(50));
+        REQUIRE(tree.search(50) == nullptr);
+    }
+
+    SECTION("order of duplicates survives rebuilds and rotations") {
+        tree.balance();
+        REQUIRE(valuesInRange(tree, 30) == std::vector<int>{1, 3, 8});
+        tree.setAccessMode(AccessMode::Splay);
+        for (int k : {70, 30, 90, 50, 30}) REQUIRE(tree.search(k) != nullptr);
+        REQUIRE(*tree.search(30) == 1);
+        tree.insert(30, 100);
+        REQUIRE(valuesInRange(tree, 30) == std::vector<int>{1, 3, 8, 100});
+        tree.setAccessMode(AccessMode::Scapegoat);
+        for (int i = 0; i < 200; ++i) tree.insert(30, 200 + i);
+        REQUIRE(tree.count(30) == 204);
+        REQUIRE(*tree.search(30) == 1);
+        REQUIRE(tree.GetDepth() <= 16);
+    }
+
+    SECTION("split, join and eraseRange keep every duplicate") {
+        auto [low, high] = tree.split(50);
+        REQUIRE(low.count(50) == 0);
+        REQUIRE(high.count(50) == 3);
+        REQUIRE(high.isMultimap());
+        BinaryTree<int> joined = BinaryTree<int>::join(std::move(low), std::move(high));
+        REQUIRE(valuesInRange(joined, 30) == std::vector<int>{1, 3, 8});
+
+        auto [left, right] = joined.split(71);
+        auto [smaller, equal] = left.split(70);
+        REQUIRE(equal.count(70) == 2);
+        REQUIRE(smaller.getMax() == 5);
+        BinaryTree<int> back = BinaryTree<int>::join(std::move(smaller), std::move(equal)); // стык по равным ключам не нужен
+        REQUIRE(back.count(70) == 2);
+
+        REQUIRE(back.eraseRange(30, 50) == 6);
+        REQUIRE(back.count(30) == 0);
+        REQUIRE(back.count(10) == 1);
+    }
+
+    SECTION("copies, bulkLoad and where carry the mode") {
+        BinaryTree<int> copy = tree;
+        copy.insert(10, 42);
+        REQUIRE(copy.count(10) == 2);
+        BinaryTree<int> assigned;
+        assigned = tree;
+        REQUIRE(assigned.isMultimap());
+
+        std::vector<std::pair<int, int>> extra = {{10, 100}, {10, 101}};
+        tree.bulkLoad(extra);
+        REQUIRE(tree.count(10) == 3);
+        auto [first, last] = tree.equalRange(10);
+        REQUIRE(*first == 6);
+
+        BinaryTree<int> even = tree.where([](const int& v) { return v % 2 == 0; });
+        REQUIRE(even.count(50) == 2);
+        REQUIRE(even.isMultimap());
+    }
+
+    SECTION("unique-key operations refuse duplicates") {
+        REQUIRE_THROWS_AS(tree.setMultimap(false), std::invalid_argument);
+        REQUIRE_THROWS_AS(tree.unionWith(tree), std::invalid_argument);
+        BinaryTree<int> other;
+        other.insert(1, 1);
+        REQUIRE_THROWS_AS(other.intersect(tree), std::invalid_argument);
+        REQUIRE_THROWS_AS(BinaryTree<int>::difference(std::move(other), std::move(tree)), std::invalid_argument);
+        REQUIRE(tree.isMultimap()); // отказ до того, как узлы забраны
+        REQUIRE(*other.search(1) == 1);
+        other.setMultimap(true);
+        other.setMultimap(false);
+        other.insert(1, 2);
+        REQUIRE(other.count(1) == 1);
+        REQUIRE(*other.search(1) == 2);
+    }
+
+    SECTION("students grouped by age") {
+        BinaryTree<Student> students;
+        students.setMultimap(true);
+        students.insert(19, Student("Ann", 19, 1, "A", 4.5));
+        students.insert(20, Student("Bob", 20, 2, "A", 3.9));
+        students.insert(19, Student("Cid", 19, 3, "B", 4.1));
+        auto [first, last] = students.equalRange(19);
+        REQUIRE(first->name == "Ann");
+        REQUIRE((++first)->name == "Cid");
+        REQUIRE(++first == last);
+        REQUIRE(students.count(19) == 2);
+    }
+}
+
+TEST_CASE("BinaryTree: reduce and transformReduce") {
+    BinaryTree<double> numbers;
+    for (int i = 1; i <= 10; ++i) numbers.insert(i, i * 0.5);
+    REQUIRE(numbers.reduce(0.0, [](const double& a, const double& b) { return a + b; }) == Approx(27.5));
+
+    BinaryTree<std::string> words;
+    words.insert(2, "b");
+    words.insert(1, "a");
+    words.insert(3, "c");
+    // порядок LKP сохраняется, поэтому некоммутативная операция тоже работает
+    REQUIRE(words.reduce("", [](const std::string& a, const std::string& b) { return a + b; }) == "abc");
+
+    BinaryTree<Student> students;
+    students.insert(1, Student("Ann", 19, 1, "B1", 4.0));
+    students.insert(2, Student("Bob", 20, 2, "B1", 3.0));
+    students.insert(3, Student("Eve", 21, 3, "B2", 5.0));
+    auto total = students.transformReduce(
+        std::pair<double, int>{0.0, 0},
+        [](const std::pair<double, int>& a, const std::pair<double, int>& b) {
+            return std::pair<double, int>{a.first + b.first, a.second + b.second};
+        },
+        [](const Student& s) { return std::pair<double, int>{s.gpa, 1}; });
+    REQUIRE(total.second == 3);
+    REQUIRE(total.first / total.second == Approx(4.0));
+
+    BinaryTree<int> empty;
+    REQUIRE(empty.reduce(7, [](const int& a, const int& b) { return a + b; }) == 7);
+}
+
+void benchmark_reduce(const std::string& filename) {
+    std::ofstream file(filename);
+    file << "N,Type,TraverseTimeMs,ReduceTimeMs\n";
+
+    for (int exp = 3; exp <= 6; ++exp) {
+        int N = static_cast<int>(std::pow(10, exp));
+        std::vector<int> keys(N);
+        std::iota(keys.begin(), keys.end(), 0);
+        std::shuffle(keys.begin(), keys.end(), std::mt19937{std::random_device{}()});
+
+        BinaryTree<double> numbers;
+        BinaryTree<Student> students;
+        for (int key : keys) {
+            numbers.insert(key, key * 0.001);
+            students.insert(key, Student("Student", 20, key, "B1", (key % 50) * 0.1));
+        }
+
+        // сумма double: обход с аккумулятором против reduce
+        double sum = 0;
+        auto t1 = std::chrono::high_resolution_clock::now();
+        numbers.traverseLKP([&](const double& v) { sum += v; });
+        auto t2 = std::chrono::high_resolution_clock::now();
+        double traverse_time = std::chrono::duration<double, std::milli>(t2 - t1).count();
+
+        t1 = std::chrono::high_resolution_clock::now();
+        double reduced = numbers.reduce(0.0, [](const double& a, const double& b) { return a + b; });
+        t2 = std::chrono::high_resolution_clock::now();
+        double reduce_time = std::chrono::duration<double, std::milli>(t2 - t1).count();
+        REQUIRE(reduced == Approx(sum));
+        file << N << ",double," << traverse_time << "," << reduce_time << "\n";
+
+        // средний GPA студентов
+        double gpa = 0;
+        t1 = std::chrono::high_resolution_clock::now();
+        students.traverseLKP([&](const Student& s) { gpa += s.gpa; });
+        t2 = std::chrono::high_resolution_clock::now();
+        traverse_time = std::chrono::duration<double, std::milli>(t2 - t1).count();
+
+        t1 = std::chrono::high_resolution_clock::now();
+        double reducedGpa = students.transformReduce(0.0,
+            [](double a, double b) { return a + b; },
+            [](const Student& s) { return s.gpa; });
+        t2 = std::chrono::high_resolution_clock::now();
+        reduce_time = std::chrono::duration<double, std::milli>(t2 - t1).count();
+        REQUIRE(reducedGpa == Approx(gpa));
+        file << N << ",Student," << traverse_time << "," << reduce_time << "\n";
+    }
+
+    file.close();
+}
+
+TEST_CASE("Benchmark: reduce vs traverse", "[Benchmark]") {
+    benchmark_reduce("benchmark_reduce.csv");
+}
+
+// поиск ключей с распределением Ципфа: обычное дерево против splay
+void benchmark_splay(const std::string& filename) {
+    std::ofstream file(filename);
+    file << "N,Lookups,StaticTimeMs,SplayTimeMs\n";
+    const int lookups = 1000000;
+    std::mt19937 rng(42);
+
+    for (int exp = 3; exp <= 6; ++exp) {
+        int N = static_cast<int>(std::pow(10, exp));
+        std::vector<std::pair<int, int>> items(N);
+        for (int i = 0; i < N; ++i) items[i] = {i, i};
+        std::shuffle(items.begin(), items.end(), rng);
+
+        // частые ключи разбросаны по всему диапазону, а не собраны у минимума
+        std::vector<int> hot(N);
+        std::iota(hot.begin(), hot.end(), 0);
+        std::shuffle(hot.begin(), hot.end(), rng);
+        ZipfDistribution zipf(N, 1.1);
+        std::vector<int> queries(lookups);
+        for (int& q : queries) q = hot[zipf(rng) - 1];
+
+        BinaryTree<int> tree;
+        for (const auto& [key, value] : items) tree.insert(key, value);
+        BinaryTree<int> splayTree = tree;
+        splayTree.setAccessMode(AccessMode::Splay);
+
+        long long sum = 0;
+        auto t1 = std::chrono::high_resolution_clock::now();
+        for (int q : queries) sum += *std::as_const(tree).search(q);
+        auto t2 = std::chrono::high_resolution_clock::now();
+        double static_time = std::chrono::duration<double, std::milli>(t2 - t1).count();
+
+        long long splaySum = 0;
+        t1 = std::chrono::high_resolution_clock::now();
+        for (int q : queries) splaySum += *splayTree.search(q);
+        t2 = std::chrono::high_resolution_clock::now();
+        double splay_time = std::chrono::duration<double, std::milli>(t2 - t1).count();
+
+        REQUIRE(sum == splaySum);
+        file << N << "," << lookups << "," << static_time << "," << splay_time << "\n";
+    }
+
+    file.close();
+}
+
+TEST_CASE("Benchmark: splay vs static on Zipf lookups", "[Benchmark]") {
+    benchmark_splay("benchmark_splay.csv");
+}
+
+// небольшие деревья только для чтения: спуск по узлам против плоского массива адаптивного режима
+void benchmark_adaptive(const std::string& filename) {
+    std::ofstream file(filename);
+    file << "N,Lookups,PlainTimeMs,AdaptiveTimeMs\n";
+    const int lookups = 2000000;
+    std::mt19937 rng(42);
+
+    for (int N : {256, 1000, 4000, 16000, 100000}) {
+        std::vector<int> keys(N);
+        for (int i = 0; i < N; ++i) keys[i] = i * 2; // половина запросов - промахи
+        std::shuffle(keys.begin(), keys.end(), rng);
+        std::uniform_int_distribution<int> dist(0, 2 * N - 1);
+        std::vector<int> queries(lookups);
+        for (int& q : queries) q = dist(rng);
+
+        BinaryTree<int> plain, adaptive;
+        adaptive.setAdaptive(true);
+        for (int key : keys) {
+            plain.insert(key, key);
+            adaptive.insert(key, key);
+        }
+        for (int key : keys) std::as_const(adaptive).search(key); // массив строится заранее
+        REQUIRE(adaptive.hasFlatIndex());
+
+        long long hits = 0;
+        auto t1 = std::chrono::high_resolution_clock::now();
+        for (int q : queries) hits += std::as_const(plain).search(q) != nullptr;
+        auto t2 = std::chrono::high_resolution_clock::now();
+        double plain_time = std::chrono::duration<double, std::milli>(t2 - t1).count();
+
+        long long adaptiveHits = 0;
+        t1 = std::chrono::high_resolution_clock::now();
+        for (int q : queries) adaptiveHits += std::as_const(adaptive).search(q) != nullptr;
+        t2 = std::chrono::high_resolution_clock::now();
+        double adaptive_time = std::chrono::duration<double, std::milli>(t2 - t1).count();
+
+        REQUIRE(hits == adaptiveHits);
+        file << N << "," << lookups << "," << plain_time << "," << adaptive_time << "\n";
+    }
+
+    file.close();
+}
+
+TEST_CASE("Benchmark: adaptive flat array vs node search", "[Benchmark]") {
+    benchmark_adaptive("benchmark_adaptive.csv");
+}
+
+// поиск в дереве студентов: значения в узлах против раздельного хранения
+void benchmark_split_layout(const std::string& filename) {
+    std::ofstream file(filename);
+    file << "N,Lookups,BinaryTreeTimeMs,SplitTreeTimeMs\n";
+    const int lookups = 1000000;
+    std::mt19937 rng(7);
+
+    for (int exp = 3; exp <= 6; ++exp) {
+        int N = static_cast<int>(std::pow(10, exp));
+        std::vector<int> keys(N);
+        std::iota(keys.begin(), keys.end(), 0);
+        std::shuffle(keys.begin(), keys.end(), rng);
+        std::uniform_int_distribution<int> pick(0, N - 1);
+        std::vector<int> queries(lookups);
+        for (int& q : queries) q = pick(rng);
+
+        long long sum = 0, splitSum = 0;
+        double tree_time = 0, split_time = 0;
+        {
+            BinaryTree<Student> tree;
+            for (int key : keys) tree.insert(key, Student("Student name " + std::to_string(key), 20, key, "Group B1", 4.0));
+            auto t1 = std::chrono::high_resolution_clock::now();
+            for (int q : queries) sum += tree.search(q)->id;
+            auto t2 = std::chrono::high_resolution_clock::now();
+            tree_time = std::chrono::duration<double, std::milli>(t2 - t1).count();
+        }
+        {
+            SplitBinaryTree<Student> tree;
+            for (int key : keys) tree.insert(key, Student("Student name " + std::to_string(key), 20, key, "Group B1", 4.0));
+            auto t1 = std::chrono::high_resolution_clock::now();
+            for (int q : queries) splitSum += tree.search(q)->id;
+            auto t2 = std::chrono::high_resolution_clock::now();
+            split_time = std::chrono::duration<double, std::milli>(t2 - t1).count();
+        }
+
+        REQUIRE(sum == splitSum);
+        file << N << "," << lookups << "," << tree_time << "," << split_time << "\n";
+    }
+
+    file.close();
+}
+
+TEST_CASE("Benchmark: split hot/cold layout on Student search", "[Benchmark]") {
+    benchmark_split_layout("benchmark_split_layout.csv");
+}
+
+// поиск по плотным (0..N-1) и разреженным (случайные int) ключам: IntKeyMap против BinaryTree<int>
+void benchmark_int_key_map(const std::string& filename) {
+    std::ofstream file(filename);
+    file << "N,Keys,BinaryTreeTimeMs,IntKeyMapTimeMs\n";
+    const int lookups = 1000000;
+    std::mt19937 rng(9);
+
+    for (int exp = 3; exp <= 6; ++exp) {
+        int N = static_cast<int>(std::pow(10, exp));
+        for (bool dense : {true, false}) {
+            std::vector<int> keys(N);
+            if (dense) std::iota(keys.begin(), keys.end(), 0);
+            else for (int& k : keys) k = static_cast<int>(rng());
+            std::shuffle(keys.begin(), keys.end(), rng);
+            std::uniform_int_distribution<int> pick(0, N - 1);
+            std::vector<int> queries(lookups);
+            for (int& q : queries) q = keys[pick(rng)];
+
+            BinaryTree<int> tree;
+            IntKeyMap<int> map;
+            for (int key : keys) {
+                tree.insert(key, key);
+                map.insert(key, key);
+            }
+
+            long long sum = 0, mapSum = 0;
+            auto t1 = std::chrono::high_resolution_clock::now();
+            for (int q : queries) sum += *tree.search(q);
+            auto t2 = std::chrono::high_resolution_clock::now();
+            double tree_time = std::chrono::duration<double, std::milli>(t2 - t1).count();
+
+            t1 = std::chrono::high_resolution_clock::now();
+            for (int q : queries) mapSum += *map.search(q);
+            t2 = std::chrono::high_resolution_clock::now();
+            double map_time = std::chrono::duration<double, std::milli>(t2 - t1).count();
+
+            REQUIRE(sum == mapSum);
+            file << N << "," << (dense ? "dense" : "sparse") << "," << tree_time << "," << map_time << "\n";
+        }
+    }
+
+    file.close();
+}
+
+TEST_CASE("Benchmark: IntKeyMap vs BinaryTree on dense and sparse keys", "[Benchmark]") {
+    benchmark_int_key_map("benchmark_int_key_map.csv");
+}
+
+// поиск, где 90% запросов - промахи: дерево без фильтра и с фильтром Блума
+void benchmark_bloom(const std::string& filename) {
+    std::ofstream file(filename);
+    file << "N,Lookups,MissRate,PlainTimeMs,FilteredTimeMs\n";
+    const int lookups = 1000000;
+    std::mt19937 rng(21);
+
+    for (int exp = 3; exp <= 6; ++exp) {
+        int N = static_cast<int>(std::pow(10, exp));
+        std::vector<std::pair<int, int>> items(N);
+        for (int i = 0; i < N; ++i) items[i] = {i * 2, i}; // в дереве только чётные ключи
+        std::shuffle(items.begin(), items.end(), rng);
+        std::uniform_int_distribution<int> pick(0, N - 1);
+        std::bernoulli_distribution miss(0.9);
+        std::vector<int> queries(lookups);
+        for (int& q : queries) q = pick(rng) * 2 + (miss(rng) ? 1 : 0);
+
+        BinaryTree<int> tree;
+        for (const auto& [key, value] : items) tree.insert(key, value);
+        BinaryTree<int> filtered = tree;
+        filtered.enableKeyFilter();
+
+        int hits = 0, filteredHits = 0;
+        auto t1 = std::chrono::high_resolution_clock::now();
+        for (int q : queries) hits += tree.search(q) != nullptr;
+        auto t2 = std::chrono::high_resolution_clock::now();
+        double plain_time = std::chrono::duration<double, std::milli>(t2 - t1).count();
+
+        t1 = std::chrono::high_resolution_clock::now();
+        for (int q : queries) filteredHits += filtered.search(q) != nullptr;
+        t2 = std::chrono::high_resolution_clock::now();
+        double filtered_time = std::chrono::duration<double, std::milli>(t2 - t1).count();
+
+        REQUIRE(hits == filteredHits);
+        file << N << "," << lookups << ",0.9," << plain_time << "," << filtered_time << "\n";
+    }
+
+    file.close();
+}
+
+TEST_CASE("Benchmark: Bloom filter on miss-heavy search", "[Benchmark]") {
+    benchmark_bloom("benchmark_bloom.csv");
+}
+
+// поиск в статическом снимке: дерево указателей, двоичный поиск по массиву и обученный индекс
+void benchmark_learned_index(const std::string& filename) {
+    std::ofstream file(filename);
+    file << "N,Lookups,TreeTimeMs,SortedArrayTimeMs,LearnedTimeMs,Segments\n";
+    const int lookups = 1000000;
+    std::mt19937 rng(47);
+
+    for (int exp = 5; exp <= 7; ++exp) {
+        int N = static_cast<int>(std::pow(10, exp));
+        std::vector<std::pair<int, int>> items(N);
+        std::uniform_int_distribution<int> gap(1, 100);
+        int key = 0;
+        for (int i = 0; i < N; ++i) items[i] = {key += gap(rng), i};
+        std::vector<int> queries(lookups);
+        std::uniform_int_distribution<int> pick(0, N - 1);
+        for (int& q : queries) q = items[pick(rng)].first;
+
+        BinaryTree<int> tree;
+        tree.bulkLoad(items);
+        LearnedIndex<int> index = LearnedIndex<int>::fromTree(tree, 32);
+        std::vector<int> sortedKeys(N);
+        for (int i = 0; i < N; ++i) sortedKeys[i] = items[i].first;
+
+        long long treeSum = 0, arraySum = 0, learnedSum = 0;
+        auto t1 = std::chrono::high_resolution_clock::now();
+        for (int q : queries) treeSum += *tree.search(q);
+        auto t2 = std::chrono::high_resolution_clock::now();
+        double tree_time = std::chrono::duration<double, std::milli>(t2 - t1).count();
+
+        t1 = std::chrono::high_resolution_clock::now();
+        for (int q : queries) arraySum += items[std::lower_bound(sortedKeys.begin(), sortedKeys.end(), q) - sortedKeys.begin()].second;
+        t2 = std::chrono::high_resolution_clock::now();
+        double array_time = std::chrono::duration<double, std::milli>(t2 - t1).count();
+
+        t1 = std::chrono::high_resolution_clock::now();
+        for (int q : queries) learnedSum += *index.search(q);
+        t2 = std::chrono::high_resolution_clock::now();
+        double learned_time = std::chrono::duration<double, std::milli>(t2 - t1).count();
+
+        REQUIRE(treeSum == arraySum);
+        REQUIRE(treeSum == learnedSum);
+        file << N << "," << lookups << "," << tree_time << "," << array_time << "," << learned_time << "," << index.segmentCount() << "\n";
+    }
+
+    file.close();
+}
+
+TEST_CASE("Benchmark: learned index vs tree vs sorted array", "[Benchmark]") {
+    benchmark_learned_index("benchmark_learned_index.csv");
+}
+
+// пересекающиеся окна: фильтр через where против спуска по наибольшим концам
+void benchmark_interval(const std::string& filename) {
+    std::ofstream file(filename);
+    file << "N,Queries,WhereTimeMs,OverlappingTimeMs\n";
+    const int queries = 200;
+    std::mt19937 rng(48);
+
+    for (int exp = 3; exp <= 5; ++exp) { // where на 10^6 идёт около минуты
+        int N = static_cast<int>(std::pow(10, exp));
+        int span = N * 10;
+        std::uniform_int_distribution<int> start(0, span), length(0, 50);
+        WindowTree tree;
+        for (int i = 0; i < N; ++i) {
+            int s = start(rng);
+            tree.insert(s, TimeWindow{s, s + length(rng), i});
+        }
+        std::vector<std::pair<int, int>> ranges(queries);
+        for (auto& r : ranges) {
+            r.first = start(rng);
+            r.second = r.first + 100;
+        }
+
+        size_t whereFound = 0, overlappingFound = 0;
+        auto t1 = std::chrono::high_resolution_clock::now();
+        for (const auto& [lo, hi] : ranges)
+            whereFound += tree.where([lo = lo, hi = hi](const TimeWindow& w) { return w.start <= hi && w.end >= lo; }).toSortedVector().size();
+        auto t2 = std::chrono::high_resolution_clock::now();
+        double where_time = std::chrono::duration<double, std::milli>(t2 - t1).count();
+
+        t1 = std::chrono::high_resolution_clock::now();
+        for (const auto& [lo, hi] : ranges) overlappingFound += tree.overlapping(lo, hi).size();
+        t2 = std::chrono::high_resolution_clock::now();
+        double overlapping_time = std::chrono::duration<double, std::milli>(t2 - t1).count();
+
+        REQUIRE(overlappingFound == whereFound);
+        file << N << "," << queries << "," << where_time << "," << overlapping_time << "\n";
+    }
+
+    file.close();
+}
+
+TEST_CASE("Benchmark: interval overlap query vs full scan", "[Benchmark]") {
+    benchmark_interval("benchmark_interval.csv");
+}
+
+// сумма значений по диапазону ключей: полный проход итератором против aggregate
+void benchmark_aggregate(const std::string& filename) {
+    std::ofstream file(filename);
+    file << "N,Queries,ScanTimeMs,AggregateTimeMs\n";
+    const int queries = 200;
+    std::mt19937 rng(49);
+
+    for (int exp = 3; exp <= 5; ++exp) { // полный проход на 10^6 идёт больше минуты
+        int N = static_cast<int>(std::pow(10, exp));
+        std::vector<std::pair<int, int>> items(N);
+        for (int i = 0; i < N; ++i) items[i] = {i, i % 1000};
+        std::shuffle(items.begin(), items.end(), rng);
+        BinaryTree<int, SumOf<IntValue>> tree;
+        for (const auto& [key, value] : items) tree.insert(key, value);
+        std::uniform_int_distribution<int> pick(0, N - 1);
+        std::vector<std::pair<int, int>> ranges(queries);
+        for (auto& [lo, hi] : ranges) {
+            lo = pick(rng);
+            hi = pick(rng);
+            if (lo > hi) std::swap(lo, hi);
+        }
+
+        long long scanSum = 0, aggregateSum = 0;
+        auto t1 = std::chrono::high_resolution_clock::now();
+        for (const auto& [lo, hi] : ranges)
+            for (auto it = tree.begin(); it != tree.end(); ++it)
+                if (it.key() >= lo && it.key() <= hi) scanSum += *it;
+        auto t2 = std::chrono::high_resolution_clock::now();
+        double scan_time = std::chrono::duration<double, std::milli>(t2 - t1).count();
+
+        t1 = std::chrono::high_resolution_clock::now();
+        for (const auto& [lo, hi] : ranges) aggregateSum += tree.aggregate(lo, hi).value_or(0);
+        t2 = std::chrono::high_resolution_clock::now();
+        double aggregate_time = std::chrono::duration<double, std::milli>(t2 - t1).count();
+
+        REQUIRE(scanSum == aggregateSum);
+        file << N << "," << queries << "," << scan_time << "," << aggregate_time << "\n";
+    }
+
+    file.close();
+}
+
+TEST_CASE("Benchmark: range aggregate vs full scan", "[Benchmark]") {
+    benchmark_aggregate("benchmark_aggregate.csv");
+}
+
 TEST_CASE("BinaryTree: serialize and deserialize") {
     BinaryTree<int> tree;
     tree.insert(20, 20);